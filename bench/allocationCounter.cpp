@@ -0,0 +1,151 @@
+#include "allocationCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> totalAllocations { 0 };
+std::atomic<size_t> totalAllocatedBytes { 0 };
+std::atomic<size_t> currentLiveBytes { 0 };
+std::atomic<size_t> currentPeakBytes { 0 };
+
+// Every block carries its size in front, so delete knows what to subtract
+constexpr size_t headerSize = alignof(std::max_align_t);
+
+void account(size_t size)
+{
+	totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	totalAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	auto live = currentLiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	auto peak = currentPeakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !currentPeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{ }
+}
+
+void* countedAlloc(size_t size)
+{
+	auto* block = static_cast<char*>(std::malloc(size + headerSize));
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+	*reinterpret_cast<size_t*>(block) = size;
+	account(size);
+	return block + headerSize;
+}
+
+// Over-aligned blocks keep the header offset and the size right before the returned pointer
+void* countedAlignedAlloc(size_t size, std::align_val_t alignment)
+{
+	auto align = std::max(static_cast<size_t>(alignment), 2 * sizeof(size_t));
+	auto total = (align + size + align - 1) / align * align;
+	auto* block = static_cast<char*>(std::aligned_alloc(align, total));
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+	auto* user = block + align;
+	reinterpret_cast<size_t*>(user)[-1] = size;
+	reinterpret_cast<size_t*>(user)[-2] = align;
+	account(size);
+	return user;
+}
+
+void countedFree(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	auto* block = static_cast<char*>(ptr) - headerSize;
+	currentLiveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+	std::free(block);
+}
+
+void countedAlignedFree(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	auto* user = static_cast<char*>(ptr);
+	currentLiveBytes.fetch_sub(reinterpret_cast<size_t*>(user)[-1], std::memory_order_relaxed);
+	std::free(user - reinterpret_cast<size_t*>(user)[-2]);
+}
+} // namespace
+
+void* operator new (size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[] (size_t size)
+{
+	return countedAlloc(size);
+}
+
+void operator delete (void* ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete[] (void* ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete (void* ptr, size_t) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete[] (void* ptr, size_t) noexcept
+{
+	countedFree(ptr);
+}
+
+void* operator new (size_t size, std::align_val_t alignment)
+{
+	return countedAlignedAlloc(size, alignment);
+}
+
+void* operator new[] (size_t size, std::align_val_t alignment)
+{
+	return countedAlignedAlloc(size, alignment);
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept
+{
+	countedAlignedFree(ptr);
+}
+
+void operator delete[] (void* ptr, std::align_val_t) noexcept
+{
+	countedAlignedFree(ptr);
+}
+
+void operator delete (void* ptr, size_t, std::align_val_t) noexcept
+{
+	countedAlignedFree(ptr);
+}
+
+void operator delete[] (void* ptr, size_t, std::align_val_t) noexcept
+{
+	countedAlignedFree(ptr);
+}
+
+namespace bench
+{
+allocationCounter allocationCounter::snapshot()
+{
+	return { totalAllocations.load(), totalAllocatedBytes.load(), currentLiveBytes.load(), currentPeakBytes.load() };
+}
+
+void allocationCounter::resetPeak()
+{
+	currentPeakBytes.store(currentLiveBytes.load());
+}
+} // namespace bench
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bench
+{
+
+// Counters fed by the global operator new/delete replacement in allocationCounter.cpp.
+// Linking that file into a target is enough to enable them.
+struct allocationCounter
+{
+	size_t allocations { 0 };
+	size_t allocatedBytes { 0 };
+	size_t liveBytes { 0 };
+	size_t peakLiveBytes { 0 };
+
+	static allocationCounter snapshot();
+	static void resetPeak();
+};
+
+} // namespace bench
\ No newline at end of file
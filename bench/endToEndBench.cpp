@@ -0,0 +1,406 @@
+#include "storageGenerator.h"
+
+#include "browser/storageBrowser.h"
+#include "data/storageImage.h"
+#include "data/xmlStorageManager.h"
+#include "utils/send_to_tmux.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// End-to-end numbers for one storage file, printed as JSON:
+//   parse_ms                 full xml parse (no lazy content, no lazy subtrees)
+//   dump_ms                  dump of the parsed tree, snapshot refresh included
+//   first_frame_ms           fork to the first frame of ui::runStorageBrowser in a pseudo-terminal,
+//                            loading through xmlStorageManager::load like the real startup
+//   keypress_to_send_ms      Enter on a root snippet to the send-keys command reaching tmux over
+//                            the control connection; a stub tmux first in PATH answers as the
+//                            control client and reports the command through a fifo. Runs where
+//                            none arrives are counted in missed_sends instead
+//
+//   tmux-snippets-bench generate <out.xml> [--depth N] [--fanout N] [--snippets N]
+//                                          [--content-min N] [--content-max N] [--seed N]
+//   tmux-snippets-bench run <storage.xml> [--runs N]
+
+namespace
+{
+using benchClock = std::chrono::steady_clock;
+
+constexpr std::string_view frameMarker = "Quit";
+constexpr int terminalRows = 40;
+constexpr int terminalColumns = 120;
+
+double msSince(benchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+}
+
+struct series
+{
+	std::vector<double> samples;
+
+	void print(const char* name, bool last) const
+	{
+		if (samples.empty())
+		{
+			std::printf("    \"%s\": null%s\n", name, last ? "" : ",");
+			return;
+		}
+
+		auto sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for (auto sample : sorted)
+		{
+			sum += sample;
+		}
+		std::printf("    \"%s\": { \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f }%s\n", name, sorted.front(), sorted[sorted.size() / 2],
+			sum / sorted.size(), sorted.back(), last ? "" : ",");
+	}
+};
+
+// The stub tmux, after a line setting FIFO. As a control client (-C) it answers every command
+// and reports the Enter of a send; run any other way it reports the call, which covers the
+// send-keys fallback.
+constexpr std::string_view stubScript = R"(if [ "$1" = -C ]; then
+  echo '%begin 0 0 0'; echo '%end 0 0 0'
+  while IFS= read -r line; do
+    echo '%begin 0 1 1'; echo '%end 0 1 1'
+    case "$line" in send-keys*' Enter') printf x > "$FIFO";; esac
+  done
+  exit 0
+fi
+printf x > "$FIFO"
+)";
+
+// Temporary directory with the stub tmux and the fifo it writes to
+class sendProbe
+{
+public:
+	sendProbe()
+	{
+		char pattern[] = "/tmp/tmux-snippets-bench-XXXXXX";
+		directory_ = ::mkdtemp(pattern);
+
+		auto fifo = directory_ / "sent";
+		::mkfifo(fifo.c_str(), 0600);
+		// Read and write end in one: the stub's open never blocks and poll never sees a hangup
+		fifo_ = ::open(fifo.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+		auto stub = directory_ / "tmux";
+		std::ofstream(stub) << "#!/bin/sh\nFIFO=\"" << fifo.string() << "\"\n" << stubScript;
+		std::filesystem::permissions(stub, std::filesystem::perms::owner_all);
+	}
+
+	~sendProbe()
+	{
+		::close(fifo_);
+		std::error_code ec;
+		std::filesystem::remove_all(directory_, ec);
+	}
+
+	const std::filesystem::path& directory() const { return directory_; }
+
+	int fifo() const { return fifo_; }
+
+	// Drops reports of earlier sends: a snippet of several lines reports each of its Enters
+	void drain() const
+	{
+		char drained[16];
+		while (::read(fifo_, drained, sizeof(drained)) > 0)
+		{ }
+	}
+
+private:
+	std::filesystem::path directory_;
+	int fifo_ { -1 };
+};
+
+class browserProcess
+{
+public:
+	browserProcess(const std::string& filename, const sendProbe& probe)
+	{
+		winsize size {};
+		size.ws_row = terminalRows;
+		size.ws_col = terminalColumns;
+
+		pid_ = ::forkpty(&master_, nullptr, nullptr, &size);
+		if (pid_ == 0)
+		{
+			auto path = probe.directory().string() + ":" + (std::getenv("PATH") ? std::getenv("PATH") : "/usr/bin:/bin");
+			::setenv("PATH", path.c_str(), 1);
+			::setenv("TERM", "xterm-256color", 1);
+
+			// Sends go over the control connection, as in main.cpp
+			utils::openTmuxControl();
+			data::xmlStorageManager manager;
+			manager.load(filename);
+			// No usage log: the sends of earlier runs would add a Recent row above the folders
+			// and move the snippet the keys below walk to
+			ui::runStorageBrowser(manager.getStorage(), "%bench", &manager.getContentIndex());
+			utils::closeTmuxControl();
+			std::fflush(stdout);
+			::_exit(0);
+		}
+	}
+
+	~browserProcess()
+	{
+		if (pid_ > 0)
+		{
+			::kill(pid_, SIGKILL);
+			::waitpid(pid_, nullptr, 0);
+		}
+		if (master_ >= 0)
+		{
+			::close(master_);
+		}
+	}
+
+	bool started() const { return pid_ > 0; }
+
+	// Reads the terminal until `marker` shows up or the timeout runs out
+	bool waitFor(std::string_view marker, int timeoutMs)
+	{
+		auto deadline = benchClock::now() + std::chrono::milliseconds(timeoutMs);
+		while (output_.find(marker) == std::string::npos)
+		{
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - benchClock::now()).count();
+			if (left <= 0 || !readSome(static_cast<int>(left)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Reads until the terminal stays quiet for `quietMs`
+	void settle(int quietMs)
+	{
+		while (readSome(quietMs))
+		{ }
+	}
+
+	void type(std::string_view keys)
+	{
+		[[maybe_unused]] auto written = ::write(master_, keys.data(), keys.size());
+	}
+
+	// Keeps draining the terminal while waiting for the stub tmux to report a send
+	bool waitForSend(int fifo, int timeoutMs)
+	{
+		auto deadline = benchClock::now() + std::chrono::milliseconds(timeoutMs);
+		while (benchClock::now() < deadline)
+		{
+			pollfd watched[2] = { { fifo, POLLIN, 0 }, { master_, POLLIN, 0 } };
+			if (::poll(watched, 2, 50) < 0)
+			{
+				continue;
+			}
+			if (watched[0].revents & POLLIN)
+			{
+				char drained[16];
+				while (::read(fifo, drained, sizeof(drained)) > 0)
+				{ }
+				return true;
+			}
+			if (watched[1].revents & POLLIN)
+			{
+				readSome(0);
+			}
+		}
+		return false;
+	}
+
+	void clearOutput() { output_.clear(); }
+
+private:
+	bool readSome(int timeoutMs)
+	{
+		pollfd watched { master_, POLLIN, 0 };
+		if (::poll(&watched, 1, timeoutMs) <= 0)
+		{
+			return false;
+		}
+
+		char buffer[16 * 1024];
+		auto received = ::read(master_, buffer, sizeof(buffer));
+		if (received <= 0)
+		{
+			return false;
+		}
+		output_.append(buffer, received);
+		return true;
+	}
+
+	pid_t pid_ { -1 };
+	int master_ { -1 };
+	std::string output_;
+};
+
+int generate(int argc, char* argv[])
+{
+	bench::storageShape shape;
+	if (argc < 3 || !bench::parseShape(argc, argv, 3, shape))
+	{
+		std::fprintf(stderr, "usage: %s generate <out.xml> [--depth N] [--fanout N] [--snippets N] [--content-min N] [--content-max N] [--seed N]\n", argv[0]);
+		return 1;
+	}
+
+	data::xmlStorageManager manager;
+	bench::generateStorage(shape, *manager.getStorage());
+	if (!manager.dump(argv[2]))
+	{
+		std::fprintf(stderr, "failed to write %s\n", argv[2]);
+		return 1;
+	}
+
+	std::fprintf(stderr, "%s: %zu folders, %zu snippets (%s)\n", argv[2], shape.folderCount(), shape.snippetCount(), bench::describeShape(shape).c_str());
+	return 0;
+}
+
+int run(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::fprintf(stderr, "usage: %s run <storage.xml> [--runs N]\n", argv[0]);
+		return 1;
+	}
+
+	std::string filename(argv[2]);
+	int runs = argc > 4 && std::string_view(argv[3]) == "--runs" ? std::max(1, std::atoi(argv[4])) : 10;
+
+	sendProbe probe;
+	series parse, dump, firstFrame, keypress;
+	size_t folders = 0;
+	size_t snippets = 0;
+	size_t rootFolders = 0;
+	bool rootHasSnippet = false;
+	int missedSends = 0;
+
+	for (int i = 0; i < runs; i++)
+	{
+		data::xmlStorageManager manager;
+		manager.setLazyContent(false);
+		manager.setLazySubtrees(false);
+
+		auto start = benchClock::now();
+		if (!manager.parse(filename))
+		{
+			std::fprintf(stderr, "failed to parse %s\n", filename.c_str());
+			return 1;
+		}
+		parse.samples.push_back(msSince(start));
+
+		start = benchClock::now();
+		manager.dump((probe.directory() / "dump.xml").string());
+		dump.samples.push_back(msSince(start));
+
+		if (i == 0)
+		{
+			auto image = data::storageImage::capture(*manager.getStorage());
+			folders = image.folders.size() - 1;
+			snippets = image.snippets.size();
+			rootFolders = manager.getStorage()->root()->subFolders_.size();
+			rootHasSnippet = !manager.getStorage()->root()->snippets_.empty();
+		}
+	}
+
+	// Make sure a fresh snapshot exists, so every frame run takes the regular startup path
+	{
+		data::xmlStorageManager manager;
+		manager.load(filename);
+	}
+
+	for (int i = 0; i < runs; i++)
+	{
+		auto start = benchClock::now();
+		browserProcess browser(filename, probe);
+		if (!browser.started() || !browser.waitFor(frameMarker, 30000))
+		{
+			std::fprintf(stderr, "the browser did not draw a frame\n");
+			return 1;
+		}
+		firstFrame.samples.push_back(msSince(start));
+
+		if (!rootHasSnippet)
+		{
+			continue;
+		}
+
+		// Folders are listed first; move to the first root snippet and let the screen catch up
+		for (size_t down = 0; down < rootFolders; down++)
+		{
+			browser.type("\x1b[B");
+		}
+		browser.settle(100);
+		probe.drain();
+
+		start = benchClock::now();
+		browser.type("\r");
+		if (browser.waitForSend(probe.fifo(), 10000))
+		{
+			keypress.samples.push_back(msSince(start));
+		}
+		else
+		{
+			missedSends++;
+		}
+	}
+
+	if (missedSends > 0)
+	{
+		std::fprintf(stderr, "%d of %d sends did not reach tmux\n", missedSends, runs);
+	}
+
+	std::printf("{\n");
+#ifdef GIT_COMMIT_HASH
+	std::printf("  \"commit\": \"%s\",\n", GIT_COMMIT_HASH);
+#endif
+	std::printf("  \"storage\": \"%s\",\n", filename.c_str());
+	std::printf("  \"file_bytes\": %llu,\n", static_cast<unsigned long long>(std::filesystem::file_size(filename)));
+	std::printf("  \"folders\": %zu,\n", folders);
+	std::printf("  \"snippets\": %zu,\n", snippets);
+	std::printf("  \"runs\": %d,\n", runs);
+	std::printf("  \"missed_sends\": %d,\n", missedSends);
+	std::printf("  \"metrics\": {\n");
+	parse.print("parse_ms", false);
+	dump.print("dump_ms", false);
+	firstFrame.print("first_frame_ms", false);
+	keypress.print("keypress_to_send_ms", true);
+	std::printf("  }\n}\n");
+	return 0;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	std::string_view command(argc > 1 ? argv[1] : "");
+	if (command == "generate")
+	{
+		return generate(argc, argv);
+	}
+	if (command == "run")
+	{
+		return run(argc, argv);
+	}
+
+	std::fprintf(stderr, "usage: %s generate <out.xml> [shape options] | run <storage.xml> [--runs N]\n", argv[0]);
+	return 1;
+}
\ No newline at end of file
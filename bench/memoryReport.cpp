@@ -0,0 +1,154 @@
+#include "allocationCounter.h"
+
+#include "data/flatStorage.h"
+#include "data/xmlStorageManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Loads a storage file into the shared_ptr tree and into the flat index-based layout and
+// prints how much heap each keeps, next to what the same strings would cost as one
+// std::string each, and how long a walk over every node takes. The flat layout does not read
+// shards, so compare on a storage without a storage.d directory.
+
+namespace
+{
+// libstdc++ keeps up to 15 characters inline
+constexpr size_t ssoCapacity = 15;
+
+struct stringCost
+{
+	size_t strings { 0 };
+	size_t heapAllocations { 0 };
+	size_t heapBytes { 0 };
+
+	void add(std::string_view value)
+	{
+		strings++;
+		if (value.size() > ssoCapacity)
+		{
+			heapAllocations++;
+			heapBytes += value.size() + 1;
+		}
+	}
+};
+
+void collect(const data::storage::folder_shared_ptr_t& folder, stringCost& cost)
+{
+	cost.add(folder->name_);
+	for (const auto& snippet : folder->snippets_)
+	{
+		cost.add(snippet->title);
+		cost.add(snippet->content());
+	}
+	for (const auto& subFolder : folder->subFolders_)
+	{
+		collect(subFolder, cost);
+	}
+}
+
+// Touches every node and string, so the walk is not optimized away
+size_t walk(const data::storage::folder_shared_ptr_t& folder)
+{
+	size_t bytes = folder->name_.size();
+	for (const auto& snippet : folder->snippets_)
+	{
+		bytes += snippet->title.size() + snippet->content().size();
+	}
+	for (const auto& subFolder : folder->subFolders_)
+	{
+		bytes += walk(subFolder);
+	}
+	return bytes;
+}
+
+size_t walk(const data::flatStorage& flat, data::flatStorage::index_t folder)
+{
+	size_t bytes = flat.folderAt(folder).name_.size();
+	flat.forEachSnippet(folder, [&bytes](data::flatStorage::index_t, const data::flatStorage::snippet& snippet) { bytes += snippet.title.size() + snippet.content.size(); });
+	flat.forEachSubFolder(folder, [&bytes, &flat](data::flatStorage::index_t index, const data::flatStorage::folder&) { bytes += walk(flat, index); });
+	return bytes;
+}
+
+// Best of a few walks, in microseconds
+template<typename Walk>
+long long timeWalk(Walk&& walkOnce)
+{
+	long long best = 0;
+	for (int i = 0; i < 5; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		volatile size_t bytes = walkOnce();
+		(void)bytes;
+		long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		best = i == 0 ? elapsed : std::min(best, elapsed);
+	}
+	return best;
+}
+
+void printArena(const data::stringArena& arena)
+{
+	const auto& stats = arena.getStats();
+	std::printf("  arena:               %zu bytes for %zu strings (%zu bytes of text, %zu interned duplicates)\n", stats.arenaBytes, stats.stored,
+		stats.storedBytes, stats.internHits);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s <storage.xml>\n", argv[0]);
+		return 1;
+	}
+	std::string filename(argv[1]);
+
+	{
+		auto before = bench::allocationCounter::snapshot();
+		data::xmlStorageManager manager;
+		// The whole tree in memory, like the flat layout holds it
+		manager.setLazyContent(false);
+		manager.setLazySubtrees(false);
+		if (!manager.parse(filename))
+		{
+			std::fprintf(stderr, "failed to parse %s\n", filename.c_str());
+			return 1;
+		}
+		auto after = bench::allocationCounter::snapshot();
+
+		stringCost cost;
+		collect(manager.getStorage()->root(), cost);
+
+		std::printf("tree storage (%s)\n", filename.c_str());
+		std::printf("  as std::string:      %zu bytes in %zu heap allocations for %zu strings (estimated)\n", cost.heapBytes, cost.heapAllocations, cost.strings);
+		printArena(manager.getStorage()->strings());
+		std::printf("  retained heap:       %zu bytes, %zu allocations during parse, peak %zu bytes\n", after.liveBytes - before.liveBytes,
+			after.allocations - before.allocations, after.peakLiveBytes - before.liveBytes);
+		std::printf("  full walk:           %lld us\n", timeWalk([&manager]() { return walk(manager.getStorage()->root()); }));
+	}
+
+	bench::allocationCounter::resetPeak();
+
+	{
+		auto before = bench::allocationCounter::snapshot();
+		data::xmlStorageManager manager;
+		data::flatStorage flat;
+		if (!manager.parse(filename, flat))
+		{
+			std::fprintf(stderr, "failed to parse %s\n", filename.c_str());
+			return 1;
+		}
+		auto after = bench::allocationCounter::snapshot();
+
+		std::printf("flat storage (%zu folders, %zu snippets)\n", flat.folderCount(), flat.snippetCount());
+		printArena(flat.strings());
+		std::printf("  retained heap:       %zu bytes, %zu allocations during parse, peak %zu bytes\n", after.liveBytes - before.liveBytes,
+			after.allocations - before.allocations, after.peakLiveBytes - before.liveBytes);
+		std::printf("  full walk:           %lld us\n", timeWalk([&flat]() { return walk(flat, flat.root()); }));
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include "microBench.h"
+
+// storage::addSnippet into the root folder of a tree of the given size
+int main(int argc, char* argv[])
+{
+	constexpr size_t batch = 1000;
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "addSnippet",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				return [fixture]()
+				{
+					for (size_t i = 0; i < batch; i++)
+					{
+						fixture->storage->addSnippet("new snippet", "git status && git log --oneline -n 5");
+					}
+					return batch;
+				};
+			} } });
+}
\ No newline at end of file
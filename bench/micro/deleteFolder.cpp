@@ -0,0 +1,21 @@
+#include "microBench.h"
+
+// storage::deleteFolder of the first root subfolder, which holds about an eighth of the tree
+int main(int argc, char* argv[])
+{
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "deleteFolder",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				if (fixture->folders.empty())
+				{
+					return []() { return size_t(0); };
+				}
+				return [fixture]()
+				{
+					fixture->storage->deleteFolder(fixture->folders.front());
+					return size_t(1);
+				};
+			} } });
+}
\ No newline at end of file
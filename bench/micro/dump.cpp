@@ -0,0 +1,31 @@
+#include "microBench.h"
+
+#include "data/storageImage.h"
+#include "data/xmlStorageManager.h"
+
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+// xmlStorageManager dump of a whole tree: capture, xml write with rename and snapshot refresh
+int main(int argc, char* argv[])
+{
+	auto path = "/tmp/tmux-snippets-micro-" + std::to_string(::getpid()) + "-dump.xml";
+	auto result = bench::runMicroBenchmarks(argc, argv,
+		{ { "dump",
+			[path](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				return [fixture, path]()
+				{
+					data::xmlStorageManager manager;
+					return size_t(manager.save(path, data::storageImage::capture(*fixture->storage)));
+				};
+			} } });
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	std::filesystem::remove(path + ".snapshot", ec);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "microBench.h"
+
+#include <algorithm>
+
+// storage::editSnippet with a new content, up to 1000 snippets spread over the whole tree
+int main(int argc, char* argv[])
+{
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "editSnippet",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				return [fixture]()
+				{
+					auto count = std::min<size_t>(1000, fixture->snippets.size());
+					auto stride = count ? fixture->snippets.size() / count : 1;
+					for (size_t i = 0; i < count; i++)
+					{
+						fixture->storage->editSnippet(fixture->snippets[i * stride], "edited", "docker compose up -d && docker compose logs -f");
+					}
+					return count;
+				};
+			} } });
+}
\ No newline at end of file
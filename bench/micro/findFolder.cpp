@@ -0,0 +1,28 @@
+#include "microBench.h"
+
+#include <algorithm>
+#include <random>
+
+// storage::findFolder over folders picked at random from the whole tree
+int main(int argc, char* argv[])
+{
+	constexpr size_t lookups = 100'000;
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "findFolder",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				auto targets = std::make_shared<std::vector<uuids::uuid>>(fixture->folders);
+				std::shuffle(targets->begin(), targets->end(), std::mt19937(1));
+				targets->resize(std::min<size_t>(targets->size(), 4096));
+				return [fixture, targets]()
+				{
+					size_t found = 0;
+					for (size_t i = 0; i < lookups; i++)
+					{
+						found += fixture->storage->findFolder((*targets)[i % targets->size()]) != nullptr;
+					}
+					return found;
+				};
+			} } });
+}
\ No newline at end of file
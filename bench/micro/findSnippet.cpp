@@ -0,0 +1,29 @@
+#include "microBench.h"
+
+#include <algorithm>
+
+// storage::findSnippet of a snippet in the current (root) folder and of the deepest snippet
+int main(int argc, char* argv[])
+{
+	constexpr size_t lookups = 100'000;
+
+	auto lookup = [](bool deep)
+	{
+		return [deep](size_t size) -> std::function<size_t()>
+		{
+			auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+			auto target = deep ? fixture->snippets.back() : fixture->snippets.front();
+			return [fixture, target]()
+			{
+				size_t found = 0;
+				for (size_t i = 0; i < lookups; i++)
+				{
+					found += fixture->storage->findSnippet(target) != nullptr;
+				}
+				return found;
+			};
+		};
+	};
+
+	return bench::runMicroBenchmarks(argc, argv, { { "findSnippet/current", lookup(false) }, { "findSnippet/deep", lookup(true) } });
+}
\ No newline at end of file
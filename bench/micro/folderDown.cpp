@@ -0,0 +1,26 @@
+#include "microBench.h"
+
+// storage::folderDown from the root into its first subfolder (setRoot in between)
+int main(int argc, char* argv[])
+{
+	constexpr size_t steps = 100'000;
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "folderDown",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				if (fixture->folders.empty())
+				{
+					return []() { return size_t(0); };
+				}
+				return [fixture]()
+				{
+					for (size_t i = 0; i < steps; i++)
+					{
+						fixture->storage->setRoot();
+						fixture->storage->folderDown(fixture->folders.front());
+					}
+					return steps;
+				};
+			} } });
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "microBench.h"
+
+#include "utils/generate_uuid.h"
+
+// utils::generate_uuid one by one and utils::generate_uuids in one batch; the size is the count
+int main(int argc, char* argv[])
+{
+	auto single = [](utils::uuid_kind kind)
+	{
+		return [kind](size_t size) -> std::function<size_t()>
+		{
+			return [size, kind]()
+			{
+				uuids::uuid last;
+				for (size_t i = 0; i < size; i++)
+				{
+					last = utils::generate_uuid(kind);
+				}
+				return last.is_nil() ? 0 : size;
+			};
+		};
+	};
+	auto batch = [](utils::uuid_kind kind)
+	{
+		return [kind](size_t size) -> std::function<size_t()>
+		{
+			return [size, kind]() { return utils::generate_uuids(size, kind).size(); };
+		};
+	};
+
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "generateUuid/random", single(utils::uuid_kind::random) },
+			{ "generateUuid/timeOrdered", single(utils::uuid_kind::time_ordered) },
+			{ "generateUuids/random", batch(utils::uuid_kind::random) },
+			{ "generateUuids/timeOrdered", batch(utils::uuid_kind::time_ordered) } });
+}
\ No newline at end of file
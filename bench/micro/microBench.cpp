@@ -0,0 +1,114 @@
+#include "microBench.h"
+
+#include "allocationCounter.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <sys/resource.h>
+
+namespace bench
+{
+namespace
+{
+constexpr size_t childrenPerFolder = 8;
+constexpr size_t snippetsPerFolder = 8;
+
+// Enough repetitions for stable numbers on small sizes, bounded wall time on big ones
+constexpr auto minMeasured = std::chrono::milliseconds(200);
+constexpr auto maxTotal = std::chrono::seconds(5);
+
+long peakRssKib()
+{
+	rusage usage {};
+	::getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+} // namespace
+
+storageFixture makeStorage(size_t nodes)
+{
+	storageFixture fixture;
+	fixture.storage = std::make_shared<data::storage>();
+	auto& target = *fixture.storage;
+
+	// Fixed seed: the same tree every run, and no random_device read per node
+	std::mt19937 random(1);
+	uuids::uuid_random_generator nextUuid { random };
+
+	std::deque<data::storage::folder_shared_ptr_t> pending { target.root() };
+	while (fixture.nodes < nodes && !pending.empty())
+	{
+		auto current = pending.front();
+		pending.pop_front();
+
+		for (size_t i = 0; i < snippetsPerFolder && fixture.nodes < nodes; i++, fixture.nodes++)
+		{
+			auto index = std::to_string(fixture.snippets.size());
+			auto snippet = target.makeSnippet("snippet " + index, "echo " + index + " && ls -la /var/log | tail -n 20", nextUuid(), false);
+			target.insertSnippet(current, snippet);
+			fixture.snippets.push_back(snippet->uuid);
+		}
+
+		for (size_t i = 0; i < childrenPerFolder && fixture.nodes < nodes; i++, fixture.nodes++)
+		{
+			auto folder = target.makeFolder("folder " + std::to_string(fixture.folders.size()), nextUuid());
+			target.insertFolder(current, folder);
+			fixture.folders.push_back(folder->uuid_);
+			pending.push_back(folder);
+		}
+	}
+	return fixture;
+}
+
+int runMicroBenchmarks(int argc, char* argv[], const std::vector<microCase>& cases)
+{
+	size_t maxSize = 1'000'000;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::string_view(argv[i]) == "--max-size")
+		{
+			maxSize = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+	}
+
+	std::printf("%-24s %10s %14s %12s %16s %14s\n", "case", "size", "ns/op", "allocs/op", "peak heap KiB", "peak RSS KiB");
+	for (const auto& current : cases)
+	{
+		for (size_t size = 10; size <= maxSize; size *= 10)
+		{
+			std::chrono::nanoseconds measured { 0 };
+			size_t operations = 0;
+			size_t allocations = 0;
+			size_t peakHeap = 0;
+
+			auto started = std::chrono::steady_clock::now();
+			while (operations == 0 || (measured < minMeasured && std::chrono::steady_clock::now() - started < maxTotal))
+			{
+				auto timed = current.setup(size);
+
+				allocationCounter::resetPeak();
+				auto before = allocationCounter::snapshot();
+				auto start = std::chrono::steady_clock::now();
+				operations += timed();
+				measured += std::chrono::steady_clock::now() - start;
+				auto after = allocationCounter::snapshot();
+
+				allocations += after.allocations - before.allocations;
+				peakHeap = std::max(peakHeap, after.peakLiveBytes);
+			}
+
+			auto perOp = [operations](double value) { return operations ? value / operations : 0.0; };
+			std::printf("%-24s %10zu %14.1f %12.2f %16zu %14ld\n", current.name, size, perOp(double(measured.count())), perOp(double(allocations)),
+				peakHeap / 1024, peakRssKib());
+			std::fflush(stdout);
+		}
+	}
+	return 0;
+}
+
+} // namespace bench
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+
+namespace bench
+{
+
+// Tree for the microbenchmarks, built breadth-first with 8 snippets and 8 subfolders per folder
+// until it holds the requested number of nodes (folders + snippets). Uuids are kept in
+// creation order, so the last ones are the deepest.
+struct storageFixture
+{
+	std::shared_ptr<data::storage> storage;
+	std::vector<uuids::uuid> folders;
+	std::vector<uuids::uuid> snippets;
+	size_t nodes { 0 };
+};
+
+storageFixture makeStorage(size_t nodes);
+
+// One measured case. setup(size) builds a fixture outside the timer and returns the callable
+// doing the timed part; that callable returns how many operations it performed.
+// Each size is repeated with fresh fixtures until enough time was measured.
+struct microCase
+{
+	const char* name;
+	std::function<std::function<size_t()>(size_t size)> setup;
+};
+
+// Sizes 10, 100, ... 1M (capped by --max-size N). Prints one line per case and size:
+// ns/op, allocations/op, peak live heap and peak RSS of the process so far.
+int runMicroBenchmarks(int argc, char* argv[], const std::vector<microCase>& cases);
+
+} // namespace bench
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "microBench.h"
+
+#include "data/storageImage.h"
+#include "data/xmlStorageManager.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include <unistd.h>
+
+// xmlStorageManager::parse of a whole file, lazy (the startup default) and eager
+namespace
+{
+std::map<size_t, std::string> files;
+
+const std::string& fileFor(size_t size)
+{
+	auto& path = files[size];
+	if (path.empty())
+	{
+		path = "/tmp/tmux-snippets-micro-" + std::to_string(::getpid()) + "-" + std::to_string(size) + ".xml";
+		auto fixture = bench::makeStorage(size);
+		data::xmlStorageManager writer;
+		writer.save(path, data::storageImage::capture(*fixture.storage));
+	}
+	return path;
+}
+
+bench::microCase parseCase(const char* name, bool lazy)
+{
+	return { name,
+		[lazy](size_t size) -> std::function<size_t()>
+		{
+			auto path = fileFor(size);
+			return [path, lazy]()
+			{
+				data::xmlStorageManager manager;
+				manager.setLazyContent(lazy);
+				manager.setLazySubtrees(lazy);
+				return size_t(manager.parse(path));
+			};
+		} };
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	auto result = bench::runMicroBenchmarks(argc, argv, { parseCase("parse/lazy", true), parseCase("parse/eager", false) });
+	for (const auto& [_, path] : files)
+	{
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		std::filesystem::remove(path + ".snapshot", ec);
+	}
+	return result;
+}
\ No newline at end of file
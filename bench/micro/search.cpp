@@ -0,0 +1,32 @@
+#include "microBench.h"
+
+#include "data/snippetSearch.h"
+
+#include <string>
+
+// snippetSearch: one keystroke of type-to-filter, typing a title character by character
+// and deleting it again
+int main(int argc, char* argv[])
+{
+	return bench::runMicroBenchmarks(argc, argv,
+		{ { "search/keystroke",
+			[](size_t size) -> std::function<size_t()>
+			{
+				auto fixture = std::make_shared<bench::storageFixture>(bench::makeStorage(size));
+				auto search = std::make_shared<data::snippetSearch>();
+				search->refresh(*fixture->storage);
+				return [search]()
+				{
+					const std::string typed = "snippet 1234";
+					for (size_t i = 1; i <= typed.size(); i++)
+					{
+						search->setQuery(std::string_view(typed).substr(0, i));
+					}
+					for (size_t i = typed.size(); i-- > 0;)
+					{
+						search->setQuery(std::string_view(typed).substr(0, i));
+					}
+					return typed.size() * 2;
+				};
+			} } });
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "browser/storageBrowser.h"
+#include "data/snapshotCache.h"
+#include "data/xmlStorageManager.h"
+
+#include <ftxui/screen/screen.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Time from an empty process state to the first rendered frame of the browser,
+// once through the xml parser and once through the binary snapshot.
+
+namespace
+{
+double firstFrameMs(const std::string& filename, bool useSnapshot)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	data::xmlStorageManager manager;
+	bool loaded = useSnapshot ? manager.load(filename) : manager.parse(filename);
+	if (!loaded)
+	{
+		std::fprintf(stderr, "failed to load %s\n", filename.c_str());
+		std::exit(1);
+	}
+
+	ui::StorageTreeView view(manager.getStorage());
+	auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(120), ftxui::Dimension::Fixed(40));
+	ftxui::Render(screen, view.GetComponent()->Render());
+
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* name, std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	std::printf("%-10s min %8.3f ms   median %8.3f ms   max %8.3f ms\n", name, samples.front(), samples[samples.size() / 2], samples.back());
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s <storage.xml> [runs]\n", argv[0]);
+		return 1;
+	}
+
+	std::string filename(argv[1]);
+	int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+	// Make sure a fresh snapshot exists before timing the fast path
+	{
+		data::xmlStorageManager manager;
+		manager.load(filename);
+	}
+
+	std::vector<double> xml;
+	std::vector<double> snapshot;
+	for (int i = 0; i < runs; i++)
+	{
+		xml.push_back(firstFrameMs(filename, false));
+		snapshot.push_back(firstFrameMs(filename, true));
+	}
+
+	report("xml", xml);
+	report("snapshot", snapshot);
+	return 0;
+}
\ No newline at end of file
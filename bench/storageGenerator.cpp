@@ -0,0 +1,130 @@
+#include "storageGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+
+namespace bench
+{
+namespace
+{
+constexpr std::string_view words[] = { "git", "docker", "kubectl", "ssh", "grep", "find", "make", "cmake", "tail", "journalctl", "systemctl", "curl",
+	"--all", "-la", "logs", "status", "build", "deploy", "restart", "| less", "&&", "--follow", "-n 100", "/var/log" };
+
+std::string makeText(std::mt19937& random, size_t size)
+{
+	std::uniform_int_distribution<size_t> pick(0, std::size(words) - 1);
+	std::string text;
+	text.reserve(size + 16);
+	while (text.size() < size)
+	{
+		// Roughly one command per line, like the snippets people keep
+		if (!text.empty())
+		{
+			text += text.size() % 64 > 48 ? '\n' : ' ';
+		}
+		text += words[pick(random)];
+	}
+	text.resize(size);
+	return text;
+}
+
+void fill(const storageShape& shape, data::storage& target, std::mt19937& random, size_t level, std::string_view prefix)
+{
+	std::uniform_real_distribution<double> exponent(std::log(double(shape.contentMin)), std::log(double(shape.contentMax)));
+	for (size_t i = 0; i < shape.snippetsPerFolder; i++)
+	{
+		auto size = static_cast<size_t>(std::exp(exponent(random)));
+		target.addSnippet(std::string(prefix) + "snippet-" + std::to_string(i) + " " + makeText(random, 16), makeText(random, size));
+	}
+
+	if (level == shape.depth)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < shape.fanOut; i++)
+	{
+		auto name = std::string(prefix) + std::to_string(i);
+		auto uuid = target.addFolder("folder-" + name);
+		target.folderDown(uuid);
+		fill(shape, target, random, level + 1, name + ".");
+		target.folderUp();
+	}
+}
+} // namespace
+
+size_t storageShape::folderCount() const
+{
+	size_t count = 0;
+	size_t levelSize = 1;
+	for (size_t level = 0; level < depth; level++)
+	{
+		levelSize *= fanOut;
+		count += levelSize;
+	}
+	return count;
+}
+
+void generateStorage(const storageShape& shape, data::storage& target)
+{
+	std::mt19937 random(shape.seed);
+	target.setRoot();
+	fill(shape, target, random, 0, "");
+	target.setRoot();
+}
+
+bool parseShape(int argc, char* argv[], int first, storageShape& shape)
+{
+	for (int i = first; i < argc; i += 2)
+	{
+		std::string_view option(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		auto value = std::strtoull(argv[i + 1], nullptr, 10);
+		if (option == "--depth")
+		{
+			shape.depth = value;
+		}
+		else if (option == "--fanout")
+		{
+			shape.fanOut = value;
+		}
+		else if (option == "--snippets")
+		{
+			shape.snippetsPerFolder = value;
+		}
+		else if (option == "--content-min")
+		{
+			shape.contentMin = std::max<size_t>(1, value);
+		}
+		else if (option == "--content-max")
+		{
+			shape.contentMax = value;
+		}
+		else if (option == "--seed")
+		{
+			shape.seed = static_cast<uint32_t>(value);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	shape.contentMax = std::max(shape.contentMax, shape.contentMin);
+	return true;
+}
+
+std::string describeShape(const storageShape& shape)
+{
+	return "depth " + std::to_string(shape.depth) + ", fan-out " + std::to_string(shape.fanOut) + ", " + std::to_string(shape.snippetsPerFolder)
+		+ " snippets per folder, content " + std::to_string(shape.contentMin) + ".." + std::to_string(shape.contentMax) + " bytes";
+}
+
+} // namespace bench
\ No newline at end of file
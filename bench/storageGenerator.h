@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "data/storage.h"
+
+namespace bench
+{
+
+// Shape of a synthetic storage: a full tree of `depth` levels below the root with `fanOut`
+// subfolders per folder and `snippetsPerFolder` snippets in every folder, the root included.
+// Content sizes are drawn log-uniformly from [contentMin, contentMax]: many short one-liners,
+// a few long scripts, like real libraries.
+struct storageShape
+{
+	size_t depth { 3 };
+	size_t fanOut { 4 };
+	size_t snippetsPerFolder { 8 };
+	size_t contentMin { 8 };
+	size_t contentMax { 2048 };
+	uint32_t seed { 1 };
+
+	size_t folderCount() const;
+	size_t snippetCount() const { return (folderCount() + 1) * snippetsPerFolder; }
+};
+
+// Fills an empty storage; the current folder is left at the root
+void generateStorage(const storageShape& shape, data::storage& target);
+
+// Parses --depth, --fanout, --snippets, --content-min, --content-max and --seed from argv
+// starting at `first`. Returns false on an unknown option or a missing value.
+bool parseShape(int argc, char* argv[], int first, storageShape& shape);
+
+std::string describeShape(const storageShape& shape);
+
+} // namespace bench
\ No newline at end of file
@@ -5,7 +5,7 @@ function(install_project)
 		"${CMAKE_SOURCE_DIR}/snippets.tmux"
 	)
 
-	install(TARGETS "${UI_EXECUTABLE}"
+	install(TARGETS "${UI_EXECUTABLE}" "${CLIENT_EXECUTABLE}"
 		RUNTIME DESTINATION "${CMAKE_INSTALL_DIR}"
 		CONFIGURATIONS Release Debug
 	)
@@ -2,9 +2,30 @@
 
 CURRENT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 CURRENT_PANE=$(tmux display-message -p '#{pane_id}')
+# "window" targets every pane of the current window, anything else is passed as the target as is
+TARGET="${CURRENT_PANE}"
+if [ "$1" = "window" ]; then
+	TARGET="window:$(tmux display-message -p '#{window_id}')"
+elif [ -n "$1" ]; then
+	TARGET="$1"
+fi
 # echo $CURRENT_PANE
+
+# set -g @snippets-daemon 'on' keeps the storage loaded in a background process between calls
+SNIPPETS_UI="tmux-snippets-ui"
+if [ "$(tmux show-option -gqv @snippets-daemon)" = "on" ]; then
+	SNIPPETS_UI="tmux-snippets-client"
+fi
+
+# set -g @snippets-bracketed-paste 'on' pastes snippets for review instead of running them
+BRACKETED_PASTE="$(tmux show-option -gqv @snippets-bracketed-paste)"
+# set -g @snippets-backend 'sqlite' keeps the storage in data/storage.db
+BACKEND="$(tmux show-option -gqv @snippets-backend)"
+# set -g @snippets-shard-size '64' moves top-level folders of 64 KiB or more into data/storage.d
+SHARD_SIZE="$(tmux show-option -gqv @snippets-shard-size)"
+
 tmux new-window -n "snippets" "
-	${CURRENT_DIR}/../tmux-snippets-ui ${CURRENT_PANE}
+	SNIPPETS_BRACKETED_PASTE=${BRACKETED_PASTE} SNIPPETS_BACKEND=${BACKEND} SNIPPETS_SHARD_SIZE=${SHARD_SIZE} ${CURRENT_DIR}/../${SNIPPETS_UI} ${TARGET}
 	tmux kill-window
 "
 
@@ -1,12 +1,12 @@
 #include "browser/storageBrowser.h"
 
 #include <ftxui/component/screen_interactive.hpp>
+#include <ftxui/screen/terminal.hpp>
 
 #include "utils/exePathManager.h"
+#include "utils/fileSnippetCache.h"
 #include "utils/send_to_tmux.h"
 
-#include <fstream>
-
 using namespace ftxui;
 
 namespace ui
@@ -37,11 +37,15 @@ InputDialog::InputDialog()
 
 			if (event == Event::Return)
 			{
-				if (callback_ && !buffer_.empty())
+				// Hidden first: the callback may show the dialog again with the next question.
+				// An empty answer is an answer too, only Escape cancels.
+				auto callback = std::move(callback_);
+				auto value = std::move(buffer_);
+				Hide();
+				if (callback)
 				{
-					callback_(buffer_);
+					callback(value);
 				}
-				Hide();
 				return true;
 			}
 			else if (event == Event::Escape)
@@ -157,8 +161,8 @@ SnippetContentView::SnippetContentView()
 			if (!visible_ || !snippet_)
 				return text("");
 
-			return vbox({ window(text("Snippet: " + snippet_->title),
-											vbox({ text("Title: " + snippet_->title) | bold, separator(), text("Content:"), paragraph(snippet_->content) | flex, separator(),
+			return vbox({ window(text("Snippet: " + std::string(snippet_->title)),
+											vbox({ text("Title: " + std::string(snippet_->title)) | bold, separator(), text("Content:"), paragraph(std::string(snippet_->content())) | flex, separator(),
 												text("UUID: " + uuids::to_string(snippet_->uuid)), text("From file: " + std::string(snippet_->from_file ? "Yes" : "No")) })
 												| flex | frame),
 							 text("Press any key to return") | center })
@@ -193,55 +197,60 @@ void SnippetContentView::Hide()
 }
 
 // StorageTreeView implementation
-StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage)
+StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage, data::contentSearch* content_index, data::usageLog* usage)
 : storage_(storage)
+, content_index_(content_index)
+, usage_(usage)
+, templates_(storage)
+, sorted_view_(storage, usage)
 {
+	prefetchFileSnippets();
+
 	component_ = Renderer(
 		[this]
 		{
+			if (searching_)
+			{
+				return renderSearch();
+			}
+			if (showing_recent_)
+			{
+				return renderRecent();
+			}
+
 			auto current_folder = storage_->currentFolder();
+			const auto& folders = sorted_view_.folders(current_folder);
+			const auto& snippets = sorted_view_.snippets(current_folder);
+			int folder_count = folders.size();
+			int first_item = GetFirstItemIndex();
 			std::vector<Element> elements;
 
-			elements.push_back(text("Current: " + getCurrentPath()) | bold);
+			elements.push_back(hbox({ text("Current: " + getCurrentPath()) | bold, filler(), text(sortOrderName()) }));
 			elements.push_back(separator());
 
-			if (!storage_->curIsRoot())
+			auto [first, last] = visibleWindow(getItemCount(current_folder));
+			for (int index = first; index < last; index++)
 			{
-				auto parent_text = "/..";
-				bool is_selected = (selected_index_ == 0);
-				auto element = text(parent_text);
-				if (is_selected)
+				Element element;
+				if (index < first_item)
 				{
-					element = element | inverted;
+					element = storage_->curIsRoot() ? text("/[Recent]") | bold : text("/..");
 				}
-				elements.push_back(element);
-			}
-
-			int folder_index = storage_->curIsRoot() ? 0 : 1;
-			for (const auto& [uuid, folder] : current_folder->subFolders_)
-			{
-				auto folder_text = "/" + folder->name_;
-				bool is_selected = (selected_index_ == folder_index);
-				auto element = text(folder_text);
-				if (is_selected)
+				else if (index - first_item < folder_count)
 				{
-					element = element | inverted;
+					element = text("/" + std::string(folders[index - first_item]->name_));
+				}
+				else
+				{
+					const auto& snippet = snippets[index - first_item - folder_count];
+					element = text(std::string(snippet->title) + (snippet->from_file ? " [FILE]" : ""));
 				}
-				elements.push_back(element);
-				folder_index++;
-			}
 
-			for (const auto& snippet : current_folder->snippets_)
-			{
-				auto snippet_text = snippet->title + (snippet->from_file ? " [FILE]" : "");
-				bool is_selected = (selected_index_ == folder_index);
-				auto element = text(snippet_text);
-				if (is_selected)
+				if (index == selected_index_)
 				{
 					element = element | inverted;
 				}
 				elements.push_back(element);
-				folder_index++;
 			}
 
 			auto list = vbox(std::move(elements));
@@ -252,17 +261,30 @@ StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage)
 	component_ |= CatchEvent(
 		[this](Event event)
 		{
+			if (searching_)
+			{
+				return handleSearchEvent(event);
+			}
+			if (showing_recent_)
+			{
+				return handleRecentEvent(event);
+			}
+
 			auto current_folder = storage_->currentFolder();
 			int item_count = getItemCount(current_folder);
 
-			if (event == Event::ArrowUp)
+			if (event == Event::Character("/"))
 			{
-				selected_index_ = std::max(0, selected_index_ - 1);
+				searching_ = true;
+				selected_index_ = 0;
+				search_query_.clear();
+				search_mode_ = SearchMode::Titles;
+				search_.refresh(*storage_);
+				updateSearch();
 				return true;
 			}
-			else if (event == Event::ArrowDown)
+			else if (handleListNavigation(event, item_count))
 			{
-				selected_index_ = std::min(item_count - 1, selected_index_ + 1);
 				return true;
 			}
 			else if (event == Event::Return)
@@ -276,6 +298,7 @@ StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage)
 				{
 					storage_->folderUp();
 					selected_index_ = 0;
+					prefetchFileSnippets();
 				}
 				return true;
 			}
@@ -309,6 +332,11 @@ StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage)
 					on_show_snippet();
 				return true;
 			}
+			else if (event == Event::Character("s"))
+			{
+				cycleSortOrder();
+				return true;
+			}
 			else if (event == Event::Escape)
 			{
 				if (on_quit)
@@ -322,50 +350,358 @@ StorageTreeView::StorageTreeView(data::storage::shared_ptr_t storage)
 
 Element StorageTreeView::createKeyHelp()
 {
-	return hbox({ text("[F1] Add "), text("[F2] Edit "), text("[F3] Add Folder "), text("[F4] View "), text("[Del] Delete "), text("[Esc] Quit") }) | bold;
+	return hbox({ text("[F1] Add "), text("[F2] Edit "), text("[F3] Add Folder "), text("[F4] View "), text("[Del] Delete "), text("[/] Search "), text("[s] Sort "), text("[Esc] Quit") })
+		| bold;
 }
 
-std::string StorageTreeView::getCurrentPath()
+Element StorageTreeView::renderSearch()
 {
-	auto current = storage_->currentFolder();
-	std::vector<std::string> path_parts;
+	static const char* mode_names[] = { "Search: ", "Content: ", "Regex: " };
 
-	auto folder = current;
-	while (folder && folder != storage_->root())
+	std::vector<Element> elements;
+	elements.push_back(text(mode_names[static_cast<int>(search_mode_)] + search_query_ + "_") | bold);
+	if (search_mode_ == SearchMode::Titles)
+	{
+		elements.push_back(text(std::to_string(search_.matchCount()) + " of " + std::to_string(search_.size()) + " snippets") | dim);
+	}
+	else
 	{
-		path_parts.push_back(folder->name_);
-		if (auto parent = folder->parent_.lock())
+		elements.push_back(text(std::to_string(content_results_.size()) + " snippets") | dim);
+	}
+	elements.push_back(separator());
+
+	auto [first, last] = visibleWindow(searchResultCount());
+	for (int index = first; index < last; index++)
+	{
+		auto snippet = searchResultAt(index);
+		auto element = hbox({ text(std::string(snippet->title) + (snippet->from_file ? " [FILE]" : "")),
+			text("  " + getFolderPath(storage_->findSnippetFolder(snippet->uuid))) | dim });
+		if (index == selected_index_)
+		{
+			element = element | inverted;
+		}
+		elements.push_back(element);
+	}
+
+	auto help = hbox({ text("[Enter] Send "), text("[Up/Down] Select "), content_index_ ? text("[Tab] Titles/Content/Regex ") : text(""),
+					text("[Esc] Back to folders") })
+		| bold;
+	return window(text("Snippets"), vbox({ help, separator(), vbox(std::move(elements)) | flex }) | flex);
+}
+
+bool StorageTreeView::handleSearchEvent(Event event)
+{
+	int item_count = searchResultCount();
+
+	if (handleListNavigation(event, item_count))
+	{
+		return true;
+	}
+
+	if (event == Event::Escape)
+	{
+		searching_ = false;
+		selected_index_ = 0;
+	}
+	else if (event == Event::Return)
+	{
+		if (selected_index_ < item_count)
 		{
-			folder = parent;
+			sendSnippet(searchResultAt(selected_index_));
+		}
+	}
+	else if (event == Event::Backspace)
+	{
+		if (search_query_.empty())
+		{
+			searching_ = false;
 		}
 		else
 		{
-			break;
+			search_query_.pop_back();
+			updateSearch();
 		}
+		selected_index_ = 0;
+	}
+	else if (event == Event::Tab && content_index_)
+	{
+		search_mode_ = static_cast<SearchMode>((static_cast<int>(search_mode_) + 1) % 3);
+		updateSearch();
+		selected_index_ = 0;
 	}
+	else if (event.is_character())
+	{
+		search_query_ += event.character();
+		updateSearch();
+		selected_index_ = 0;
+	}
+
+	// Editing keys of the folder view do not apply to search results
+	return true;
+}
 
-	path_parts.push_back("/");
-	std::reverse(path_parts.begin(), path_parts.end());
+void StorageTreeView::updateSearch()
+{
+	// Same cap as the title search, the list only shows what fits on the screen anyway
+	constexpr size_t result_limit = 200;
 
-	std::string path;
-	for (size_t i = 0; i < path_parts.size(); ++i)
+	switch (search_mode_)
 	{
-		path += path_parts[i];
-		if (i > 0)
-			path += "/";
+	case SearchMode::Titles:
+		search_.setQuery(search_query_, result_limit);
+		break;
+	case SearchMode::Content:
+		content_results_ = content_index_->findSubstring(search_query_, result_limit);
+		break;
+	case SearchMode::Regex:
+		content_results_ = content_index_->findRegex(search_query_, result_limit);
+		break;
 	}
+}
 
-	return path;
+int StorageTreeView::searchResultCount() const
+{
+	return search_mode_ == SearchMode::Titles ? search_.results().size() : content_results_.size();
 }
 
-int StorageTreeView::getItemCount(const data::storage::folder_shared_ptr_t& folder)
+data::storage::snippet_shared_ptr_t StorageTreeView::searchResultAt(int index) const
 {
-	int count = folder->subFolders_.size() + folder->snippets_.size();
-	if (!storage_->curIsRoot())
+	return search_mode_ == SearchMode::Titles ? search_.results()[index].snippet : content_results_[index];
+}
+
+bool StorageTreeView::handleListNavigation(const Event& event, int item_count)
+{
+	int page = visibleRowCount();
+	int last = std::max(0, item_count - 1);
+
+	if (event == Event::ArrowUp)
+		selected_index_ = std::max(0, selected_index_ - 1);
+	else if (event == Event::ArrowDown)
+		selected_index_ = std::min(last, selected_index_ + 1);
+	else if (event == Event::PageUp)
+		selected_index_ = std::max(0, selected_index_ - page);
+	else if (event == Event::PageDown)
+		selected_index_ = std::min(last, selected_index_ + page);
+	else if (event == Event::Home)
+		selected_index_ = 0;
+	else if (event == Event::End)
+		selected_index_ = last;
+	else
+		return false;
+
+	return true;
+}
+
+int StorageTreeView::visibleRowCount() const
+{
+	// Window border, key help, current path and two separators; search shows the query and the
+	// match count in place of the path
+	int chrome_rows = searching_ ? 7 : 6;
+	return std::max(1, Terminal::Size().dimy - chrome_rows);
+}
+
+std::pair<int, int> StorageTreeView::visibleWindow(int item_count)
+{
+	int height = visibleRowCount();
+
+	if (selected_index_ < scroll_offset_)
+		scroll_offset_ = selected_index_;
+	else if (selected_index_ >= scroll_offset_ + height)
+		scroll_offset_ = selected_index_ - height + 1;
+	scroll_offset_ = std::max(0, std::min(scroll_offset_, item_count - height));
+
+	return { scroll_offset_, std::min(item_count, scroll_offset_ + height) };
+}
+
+int StorageTreeView::GetFirstItemIndex() const
+{
+	return (!storage_->curIsRoot() || hasRecentRow()) ? 1 : 0;
+}
+
+bool StorageTreeView::hasRecentRow() const
+{
+	return usage_ && !usage_->empty() && storage_->curIsRoot();
+}
+
+Element StorageTreeView::renderRecent()
+{
+	std::vector<Element> elements;
+	elements.push_back(text("Current: /[Recent]") | bold);
+	elements.push_back(separator());
+
+	auto [first, last] = visibleWindow(recent_.size() + 1);
+	for (int index = first; index < last; index++)
+	{
+		if (index == 0)
+		{
+			auto parent = text("/..");
+			elements.push_back(selected_index_ == 0 ? parent | inverted : parent);
+			continue;
+		}
+
+		const auto& snippet = recent_[index - 1];
+		auto entry = usage_->find(snippet->uuid);
+		auto element = hbox({ text(std::string(snippet->title) + (snippet->from_file ? " [FILE]" : "")),
+			text("  " + getFolderPath(storage_->findSnippetFolder(snippet->uuid)) + "  x" + std::to_string(entry ? entry->count : 0)) | dim });
+		if (index == selected_index_)
+		{
+			element = element | inverted;
+		}
+		elements.push_back(element);
+	}
+
+	auto help = hbox({ text("[Enter] Send "), text("[Up/Down] Select "), text("[Esc] Back to folders") }) | bold;
+	return window(text("Snippets"), vbox({ help, separator(), vbox(std::move(elements)) | flex }) | flex);
+}
+
+bool StorageTreeView::handleRecentEvent(Event event)
+{
+	int item_count = recent_.size() + 1;
+
+	if (handleListNavigation(event, item_count))
+	{
+		return true;
+	}
+
+	if (event == Event::Escape || event == Event::Backspace || (event == Event::Return && selected_index_ == 0))
+	{
+		showing_recent_ = false;
+		selected_index_ = 0;
+	}
+	else if (event == Event::Return)
+	{
+		if (selected_index_ < item_count)
+		{
+			sendSnippet(recent_[selected_index_ - 1]);
+		}
+	}
+
+	// The list is not a folder, editing keys do not apply to it
+	return true;
+}
+
+void StorageTreeView::sendSnippet(const data::storage::snippet_shared_ptr_t& snippet)
+{
+	if (auto parsed = templates_.get(*snippet))
+	{
+		if (on_fill_template)
+		{
+			on_fill_template(snippet, parsed);
+			return;
+		}
+		SendSnippet(snippet, parsed->fill(std::vector<std::string> {}));
+		return;
+	}
+	SendSnippet(snippet);
+}
+
+void StorageTreeView::SendSnippet(const data::storage::snippet_shared_ptr_t& snippet, std::optional<std::string_view> content)
+{
+	if (usage_)
+	{
+		usage_->recordUse(snippet->uuid);
+	}
+	// The browser closes right after, so failed targets are reported in the tmux status line
+	auto failed = sendSnippetToPane(snippet, paneToSendCommand, content);
+	if (!failed.empty())
+	{
+		std::string message = "tmux-snippets: sending failed for";
+		for (const auto& target : failed)
+		{
+			message += " " + target;
+		}
+		utils::displayTmuxMessage(message);
+	}
+
+	if (on_quit)
+		on_quit();
+}
+
+data::storage::folder_shared_ptr_t StorageTreeView::GetSelectedFolder()
+{
+	if (searching_ || showing_recent_)
 	{
-		count++;
+		return nullptr;
 	}
-	return count;
+
+	int index = selected_index_ - GetFirstItemIndex();
+	const auto& folders = sorted_view_.folders(storage_->currentFolder());
+	return index >= 0 && index < folders.size() ? folders[index] : nullptr;
+}
+
+data::storage::snippet_shared_ptr_t StorageTreeView::GetSelectedSnippet()
+{
+	if (searching_ || showing_recent_)
+	{
+		return nullptr;
+	}
+
+	auto current_folder = storage_->currentFolder();
+	int index = selected_index_ - GetFirstItemIndex() - sorted_view_.folders(current_folder).size();
+	const auto& snippets = sorted_view_.snippets(current_folder);
+	return index >= 0 && index < snippets.size() ? snippets[index] : nullptr;
+}
+
+// [s] goes through the orders; the last used one only with a usage log
+void StorageTreeView::cycleSortOrder()
+{
+	using order = data::sortedFolderView::order;
+	switch (sorted_view_.getOrder())
+	{
+	case order::stored:
+		sorted_view_.setOrder(order::name);
+		break;
+	case order::name:
+		sorted_view_.setOrder(usage_ ? order::lastUsed : order::stored);
+		break;
+	case order::lastUsed:
+		sorted_view_.setOrder(order::stored);
+		break;
+	}
+	selected_index_ = 0;
+	scroll_offset_ = 0;
+}
+
+std::string StorageTreeView::sortOrderName() const
+{
+	switch (sorted_view_.getOrder())
+	{
+	case data::sortedFolderView::order::name:
+		return "by name";
+	case data::sortedFolderView::order::lastUsed:
+		return "by last use";
+	default:
+		return "as created";
+	}
+}
+
+// Files of the folder just entered are mapped in the background, before one of them is sent
+void StorageTreeView::prefetchFileSnippets()
+{
+	std::vector<std::filesystem::path> files;
+	for (const auto& snippet : storage_->currentFolder()->snippets_)
+	{
+		if (snippet->from_file)
+		{
+			files.push_back(utils::exePathManager::getInstance().getFileSnippetPath(std::string(snippet->content())));
+		}
+	}
+	utils::fileSnippetCache::getInstance().prefetch(std::move(files));
+}
+
+const std::string& StorageTreeView::getCurrentPath() const
+{
+	return storage_->currentPath();
+}
+
+std::string StorageTreeView::getFolderPath(const data::storage::folder_shared_ptr_t& folder) const
+{
+	return storage_->folderPath(folder);
+}
+
+int StorageTreeView::getItemCount(const data::storage::folder_shared_ptr_t& folder)
+{
+	return folder->subFolders_.size() + folder->snippets_.size() + GetFirstItemIndex();
 }
 
 void StorageTreeView::handleEnter(const data::storage::folder_shared_ptr_t& current_folder)
@@ -378,89 +714,123 @@ void StorageTreeView::handleEnter(const data::storage::folder_shared_ptr_t& curr
 		{
 			storage_->folderUp();
 			selected_index_ = 0;
+			prefetchFileSnippets();
 			return;
 		}
 		adjusted_index--;
 	}
-
-	if (adjusted_index < current_folder->subFolders_.size())
-	{
-		auto it = current_folder->subFolders_.begin();
-		std::advance(it, adjusted_index);
-		storage_->folderDown(it->first);
-		selected_index_ = 0;
-		return;
-	}
-
-	if (adjusted_index >= current_folder->subFolders_.size())
+	else if (hasRecentRow())
 	{
-		int snippet_index = adjusted_index - current_folder->subFolders_.size();
-		if (snippet_index < current_folder->snippets_.size())
+		if (adjusted_index == 0)
 		{
-			auto snippet = current_folder->snippets_[snippet_index];
-			std::string content_to_send;
+			// Snippets of folders that were not entered yet are only found once the tree is loaded
+			auto recent = usage_->recent();
+			if (!storage_->fullyLoaded()
+				&& std::any_of(recent.begin(), recent.end(), [this](const auto& uuid) { return !storage_->findSnippet(uuid); }))
+			{
+				storage_->loadAll();
+			}
 
-			if (snippet->from_file)
+			recent_.clear();
+			for (const auto& uuid : recent)
 			{
-				std::filesystem::path file_path = utils::exePathManager::getInstance().getFileSnippetPath(snippet->content);
-				std::ifstream file(file_path);
-				if (file.is_open())
+				if (auto snippet = storage_->findSnippet(uuid))
 				{
-					std::stringstream buffer;
-					buffer << file.rdbuf();
-					content_to_send = buffer.str();
-					file.close();
+					recent_.push_back(snippet);
+				}
+				else if (storage_->fullyLoaded())
+				{
+					// Deleted outside this process: kept in the log it would load the tree on every open
+					usage_->forget(uuid);
 				}
 			}
-			else
-			{
-				// Используем содержимое напрямую
-				content_to_send = snippet->content;
-			}
-
-			utils::sendCommandToTmux(content_to_send, paneToSendCommand);
-
-			if (on_quit)
-				on_quit();
+			showing_recent_ = true;
+			selected_index_ = recent_.empty() ? 0 : 1;
 			return;
 		}
+		adjusted_index--;
+	}
+
+	const auto& folders = sorted_view_.folders(current_folder);
+	if (adjusted_index < folders.size())
+	{
+		storage_->folderDown(folders[adjusted_index]->uuid_);
+		selected_index_ = 0;
+		prefetchFileSnippets();
+		return;
 	}
 
-	return;
+	int snippet_index = adjusted_index - folders.size();
+	const auto& snippets = sorted_view_.snippets(current_folder);
+	if (snippet_index < snippets.size())
+	{
+		sendSnippet(snippets[snippet_index]);
+	}
 }
 
-storageBrowser::storageBrowser(data::storage::shared_ptr_t storage, std::function<void()> on_quit)
+storageBrowser::storageBrowser(data::storage::shared_ptr_t storage, std::function<void()> on_quit, data::contentSearch* content_index,
+	data::usageLog* usage, bool read_only)
 : storage_(storage)
-, tree_view_(storage)
+, tree_view_(storage, content_index, usage)
 {
 	tree_view_.on_show_snippet = [this]()
 	{
 		handleShowSnippet();
 	};
-	tree_view_.on_edit_item = [this]()
+	if (read_only)
 	{
-		handleEditItem();
-	};
-	tree_view_.on_add_snippet = [this]()
-	{
-		handleAddSnippet();
-	};
-	tree_view_.on_add_folder = [this]()
+		auto refuse = []()
+		{
+			utils::displayTmuxMessage("tmux-snippets: read-only, the storage is open in another window");
+		};
+		tree_view_.on_edit_item = refuse;
+		tree_view_.on_add_snippet = refuse;
+		tree_view_.on_add_folder = refuse;
+		tree_view_.on_delete = refuse;
+	}
+	else
 	{
-		handleAddFolder();
-	};
-	tree_view_.on_delete = [this]()
+		tree_view_.on_edit_item = [this]()
+		{
+			handleEditItem();
+		};
+		tree_view_.on_add_snippet = [this]()
+		{
+			handleAddSnippet();
+		};
+		tree_view_.on_add_folder = [this]()
+		{
+			handleAddFolder();
+		};
+		tree_view_.on_delete = [this]()
+		{
+			handleDelete();
+		};
+	}
+	tree_view_.on_fill_template = [this](const data::storage::snippet_shared_ptr_t& snippet, const data::templateCache::template_ptr_t& parsed)
 	{
-		handleDelete();
+		promptTemplateValue(snippet, parsed, {});
 	};
 	tree_view_.on_quit = on_quit;
 }
 
 Component storageBrowser::createComponent()
 {
-	auto component = Renderer([this] { return this->render(); });
+	// The saver thread captures the storage while holding its lock, and reading it can fill a
+	// placeholder or cache a lazy body
+	auto component = Renderer(
+		[this]
+		{
+			auto lock = storage_->lock();
+			return this->render();
+		});
 
-	return CatchEvent(component, [this](Event event) { return this->handleEvent(event); });
+	return CatchEvent(component,
+		[this](Event event)
+		{
+			auto lock = storage_->lock();
+			return this->handleEvent(event);
+		});
 }
 
 Element storageBrowser::render()
@@ -522,42 +892,23 @@ void storageBrowser::handleAddSnippet()
 
 void storageBrowser::handleEditItem()
 {
-	auto current_folder = storage_->currentFolder();
-	int adjusted_index = tree_view_.GetSelectedIndex();
-
-	if (!storage_->curIsRoot())
-	{
-		if (adjusted_index == 0)
-			return;
-		adjusted_index--;
-	}
-
 	// Если выбран сниппет - открываем многострочное редактирование
-	if (adjusted_index >= current_folder->subFolders_.size())
+	if (auto snippet = tree_view_.GetSelectedSnippet())
 	{
-		int snippet_index = adjusted_index - current_folder->subFolders_.size();
-		if (snippet_index < current_folder->snippets_.size())
-		{
-			auto snippet = current_folder->snippets_[snippet_index];
-			multi_input_dialog_.Show(
-				"Edit Snippet",
-				[this, snippet](const std::string& title, const std::string& content, bool from_file)
+		multi_input_dialog_.Show(
+			"Edit Snippet",
+			[this, snippet](const std::string& title, const std::string& content, bool from_file)
+			{
+				if (!title.empty() && !content.empty())
 				{
-					if (!title.empty() && !content.empty())
-					{
-						storage_->editSnippet(snippet->uuid, title, content, from_file);
-					}
-				},
-				snippet->title, snippet->content, snippet->from_file);
-		}
+					storage_->editSnippet(snippet->uuid, title, content, from_file);
+				}
+			},
+			std::string(snippet->title), std::string(snippet->content()), snippet->from_file);
 	}
 	// Если выбрана папка - открываем простое переименование
-	else if (adjusted_index < current_folder->subFolders_.size())
+	else if (auto folder = tree_view_.GetSelectedFolder())
 	{
-		auto it = current_folder->subFolders_.begin();
-		std::advance(it, adjusted_index);
-		auto folder = it->second;
-
 		input_dialog_.Show(
 			"Rename Folder",
 			[this, folder](const std::string& new_name)
@@ -567,7 +918,7 @@ void storageBrowser::handleEditItem()
 					storage_->renameFolder(folder->uuid_, new_name);
 				}
 			},
-			folder->name_);
+			std::string(folder->name_));
 	}
 }
 
@@ -585,61 +936,93 @@ void storageBrowser::handleAddFolder()
 
 void storageBrowser::handleDelete()
 {
-	auto current_folder = storage_->currentFolder();
-	int adjusted_index = tree_view_.GetSelectedIndex();
-
-	if (!storage_->curIsRoot())
+	if (auto folder = tree_view_.GetSelectedFolder())
 	{
-		if (adjusted_index == 0)
-			return;
-		adjusted_index--;
+		storage_->deleteFolder(folder->uuid_);
 	}
-
-	if (adjusted_index < current_folder->subFolders_.size())
+	else if (auto snippet = tree_view_.GetSelectedSnippet())
 	{
-		auto it = current_folder->subFolders_.begin();
-		std::advance(it, adjusted_index);
-		storage_->deleteFolder(it->first);
+		storage_->deleteSnippet(snippet->uuid);
 	}
-	else
+}
+
+// One dialog per variable of the template, in the order they appear; the snippet is sent after the last
+void storageBrowser::promptTemplateValue(const data::storage::snippet_shared_ptr_t& snippet, const data::templateCache::template_ptr_t& parsed,
+	std::vector<std::string> values)
+{
+	const auto& variables = parsed->variables();
+	if (values.size() == variables.size())
 	{
-		int snippet_index = adjusted_index - current_folder->subFolders_.size();
-		if (snippet_index < current_folder->snippets_.size())
-		{
-			auto snippet = current_folder->snippets_[snippet_index];
-			storage_->deleteSnippet(snippet->uuid);
-		}
+		tree_view_.SendSnippet(snippet, parsed->fill(values));
+		return;
 	}
+
+	const auto& variable = variables[values.size()];
+	auto previous = template_values_.find(variable.name);
+	input_dialog_.Show(
+		"{{" + variable.name + "}}",
+		[this, snippet, parsed, values](const std::string& value) mutable
+		{
+			template_values_[parsed->variables()[values.size()].name] = value;
+			values.push_back(value);
+			promptTemplateValue(snippet, parsed, std::move(values));
+		},
+		previous != template_values_.end() ? previous->second : variable.defaultValue.value_or(""));
 }
 
 void storageBrowser::handleShowSnippet()
 {
-	auto current_folder = storage_->currentFolder();
-	int adjusted_index = tree_view_.GetSelectedIndex();
+	if (auto snippet = tree_view_.GetSelectedSnippet())
+	{
+		snippet_view_.Show(snippet);
+	}
+}
 
-	if (!storage_->curIsRoot())
+std::vector<std::string> sendSnippetToPane(const data::storage::snippet_shared_ptr_t& snippet, const std::string& pane,
+	std::optional<std::string_view> content)
+{
+	if (!content && !snippet->from_file)
 	{
-		if (adjusted_index == 0)
-			return;
-		adjusted_index--;
+		content = snippet->content();
+	}
+
+	if (!utils::isBroadcastTarget(pane))
+	{
+		bool sent = content
+			// Используем содержимое напрямую
+			? utils::sendCommandToTmux(*content, pane)
+			: utils::sendFileToTmux(utils::exePathManager::getInstance().getFileSnippetPath(std::string(snippet->content())), pane);
+		return sent ? std::vector<std::string> {} : std::vector<std::string> { pane };
 	}
 
-	if (adjusted_index >= current_folder->subFolders_.size())
+	// An entry that names no pane sent nothing, which is a failure like a refused send
+	std::vector<std::string> failed;
+	auto targets = utils::resolveTmuxTargets(pane, &failed);
+	auto results = content
+		? utils::broadcastToTmux(*content, targets)
+		: utils::broadcastFileToTmux(utils::exePathManager::getInstance().getFileSnippetPath(std::string(snippet->content())), targets);
+
+	for (const auto& result : results)
 	{
-		int snippet_index = adjusted_index - current_folder->subFolders_.size();
-		if (snippet_index < current_folder->snippets_.size())
+		if (!result.ok)
 		{
-			snippet_view_.Show(current_folder->snippets_[snippet_index]);
+			failed.push_back(result.target);
 		}
 	}
+	return failed;
 }
 
-void runStorageBrowser(data::storage::shared_ptr_t storage, const std::string& pane)
+void runStorageBrowser(data::storage::shared_ptr_t storage, const std::string& pane, data::contentSearch* content_index,
+	data::usageLog* usage, std::function<void(std::function<void()>)> on_start, bool read_only)
 {
 	paneToSendCommand = pane;
 	auto screen = ScreenInteractive::TerminalOutput();
-	storageBrowser browser(storage, [&screen]() { screen.Exit(); });
+	storageBrowser browser(storage, [&screen]() { screen.Exit(); }, content_index, usage, read_only);
 	auto component = browser.createComponent();
+	if (on_start)
+	{
+		on_start(screen.ExitLoopClosure());
+	}
 	screen.Loop(component);
 }
 
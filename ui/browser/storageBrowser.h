@@ -5,6 +5,11 @@
 #include <ftxui/component/component_base.hpp>
 #include <ftxui/component/component_options.hpp>
 
+#include "data/snippetSearch.h"
+#include "data/snippetTemplate.h"
+#include "data/sortedFolderView.h"
+#include "data/contentSearch.h"
+#include "data/usageLog.h"
 #include "data/storage.h"
 
 namespace ui
@@ -77,15 +82,27 @@ private:
 class StorageTreeView
 {
 public:
-	StorageTreeView(data::storage::shared_ptr_t storage);
+	StorageTreeView(data::storage::shared_ptr_t storage, data::contentSearch* content_index = nullptr, data::usageLog* usage = nullptr);
 
 	void SetSelectedIndex(int index) { selected_index_ = index; }
 
 	int GetSelectedIndex() const { return selected_index_; }
 
+	// Rows before the folders of the current level: "/.." below the root, the Recent view at the root
+	int GetFirstItemIndex() const;
+
+	// The folder or snippet on the selected row of the current folder, in the order shown; nullptr otherwise
+	data::storage::folder_shared_ptr_t GetSelectedFolder();
+	data::storage::snippet_shared_ptr_t GetSelectedSnippet();
+
 	ftxui::Component GetComponent() { return component_; }
 
+	// Sends the snippet, with content in place of its own when given, and closes the browser
+	void SendSnippet(const data::storage::snippet_shared_ptr_t& snippet, std::optional<std::string_view> content = std::nullopt);
+
 	std::function<void()> on_quit;
+	// Asks for the values of a template before it is sent; without it the defaults are used
+	std::function<void(const data::storage::snippet_shared_ptr_t&, const data::templateCache::template_ptr_t&)> on_fill_template;
 	std::function<void()> on_show_snippet;
 	std::function<void()> on_edit_item;
 	std::function<void()> on_add_snippet;
@@ -94,19 +111,63 @@ public:
 
 private:
 	ftxui::Element createKeyHelp();
-	std::string getCurrentPath();
+	ftxui::Element renderSearch();
+	bool handleSearchEvent(ftxui::Event event);
+	void updateSearch();
+	int searchResultCount() const;
+	data::storage::snippet_shared_ptr_t searchResultAt(int index) const;
+	bool hasRecentRow() const;
+	bool handleListNavigation(const ftxui::Event& event, int item_count);
+	int visibleRowCount() const;
+	std::pair<int, int> visibleWindow(int item_count);
+	ftxui::Element renderRecent();
+	bool handleRecentEvent(ftxui::Event event);
+	const std::string& getCurrentPath() const;
+	std::string getFolderPath(const data::storage::folder_shared_ptr_t& folder) const;
 	int getItemCount(const data::storage::folder_shared_ptr_t& folder);
 	void handleEnter(const data::storage::folder_shared_ptr_t& current_folder);
+	void sendSnippet(const data::storage::snippet_shared_ptr_t& snippet);
+	void prefetchFileSnippets();
+	void cycleSortOrder();
+	std::string sortOrderName() const;
 
 	data::storage::shared_ptr_t storage_;
 	int selected_index_ = 0;
+	// First list row on screen; lists only build elements for the rows between it and the screen height
+	int scroll_offset_ = 0;
 	ftxui::Component component_;
+
+	// Search mode ([/]): typed characters filter every snippet title in the storage.
+	// With a content index [Tab] switches to substring and regex search over the contents.
+	enum class SearchMode
+	{
+		Titles,
+		Content,
+		Regex
+	};
+
+	bool searching_ = false;
+	SearchMode search_mode_ = SearchMode::Titles;
+	std::string search_query_;
+	data::snippetSearch search_;
+	data::contentSearch* content_index_;
+	std::vector<data::storage::snippet_shared_ptr_t> content_results_;
+
+	// Recent view: the most frecently sent snippets, listed above the root folders
+	data::usageLog* usage_;
+	bool showing_recent_ = false;
+	std::vector<data::storage::snippet_shared_ptr_t> recent_;
+
+	data::templateCache templates_;
+	data::sortedFolderView sorted_view_;
 };
 
 class storageBrowser
 {
 public:
-	storageBrowser(data::storage::shared_ptr_t storage, std::function<void()> on_quit);
+	// A read-only browser sends snippets but never changes the storage
+	storageBrowser(data::storage::shared_ptr_t storage, std::function<void()> on_quit, data::contentSearch* content_index = nullptr,
+		data::usageLog* usage = nullptr, bool read_only = false);
 	ftxui::Component createComponent();
 
 private:
@@ -118,8 +179,12 @@ private:
 	void handleAddFolder();
 	void handleDelete();
 	void handleShowSnippet();
+	void promptTemplateValue(const data::storage::snippet_shared_ptr_t& snippet, const data::templateCache::template_ptr_t& parsed,
+		std::vector<std::string> values);
 
 	data::storage::shared_ptr_t storage_;
+	// Values given for template variables, offered again the next time a variable of that name is asked
+	std::unordered_map<std::string, std::string> template_values_;
 
 	StorageTreeView tree_view_;
 	InputDialog input_dialog_;
@@ -127,6 +192,16 @@ private:
 	SnippetContentView snippet_view_;
 };
 
-void runStorageBrowser(data::storage::shared_ptr_t storage, const std::string& pane);
+// Sends the content itself, or the file it names for from_file snippets, to the pane; content replaces
+// them when given, such as a filled template. A broadcast target (see utils::resolveTmuxTargets) sends
+// to all its panes at once and returns the ones that failed.
+std::vector<std::string> sendSnippetToPane(const data::storage::snippet_shared_ptr_t& snippet, const std::string& pane,
+	std::optional<std::string_view> content = std::nullopt);
+
+// on_start receives a closure that closes the browser; it may be called from another thread.
+// Without a content index only snippet titles can be searched, without a usage log there is no Recent view.
+// read_only turns off adding, editing and deleting, for a browser next to another process that saves the storage.
+void runStorageBrowser(data::storage::shared_ptr_t storage, const std::string& pane, data::contentSearch* content_index = nullptr,
+	data::usageLog* usage = nullptr, std::function<void(std::function<void()>)> on_start = nullptr, bool read_only = false);
 
 } // namespace ui
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "server/protocol.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Thin client of the resident mode: hands its terminal to the daemon and waits, so the
+// window shows the browser without loading the storage again. Starts the daemon when nobody
+// answers and falls back to the standalone browser when it cannot be reached at all, or to a
+// read-only one while the daemon is busy with another window.
+//
+//   tmux-snippets-client <pane>               browse and send to <pane>
+//   tmux-snippets-client --list [folder]      print a folder
+//   tmux-snippets-client --send <uuid> <pane> [name=value ...]
+//                                             send a snippet without opening the browser
+//   tmux-snippets-client --quit               stop the daemon
+
+namespace
+{
+int winchPipe[2] = { -1, -1 };
+
+void onWinch(int)
+{
+	auto saved = errno;
+	[[maybe_unused]] auto written = ::write(winchPipe[1], "w", 1);
+	errno = saved;
+}
+
+void startDaemon(const std::filesystem::path& ui)
+{
+	auto pid = ::fork();
+	if (pid != 0)
+	{
+		return;
+	}
+
+	// Detached from the window: a killed window must not take the daemon with it
+	::setsid();
+	int null = ::open("/dev/null", O_RDWR);
+	::dup2(null, STDIN_FILENO);
+	::dup2(null, STDOUT_FILENO);
+	::dup2(null, STDERR_FILENO);
+	::execl(ui.c_str(), ui.c_str(), "--daemon", nullptr);
+	::_exit(127);
+}
+
+int connectOrStart(const std::filesystem::path& ui)
+{
+	auto path = server::socketPath();
+	if (path.empty())
+	{
+		std::fprintf(stderr, "tmux-snippets: socket directory is not private, not using the daemon\n");
+		return -1;
+	}
+
+	int fd = server::connectTo(path);
+	if (fd < 0)
+	{
+		startDaemon(ui);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+		while (fd < 0 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			fd = server::connectTo(path);
+		}
+	}
+
+	// The terminal fds go to whoever listens on the socket, so it has to be one of our processes
+	if (fd >= 0 && !server::peerIsSameUser(fd))
+	{
+		std::fprintf(stderr, "tmux-snippets: daemon socket belongs to another user\n");
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Without a daemon the window gets its own browser. Next to a daemon that is showing another
+// session it is read-only: the daemon never reloads the storage, and its next save would write
+// over whatever this browser saved.
+int runStandalone(const std::filesystem::path& ui, const std::string& pane, bool readOnly = false)
+{
+	if (readOnly)
+	{
+		::execl(ui.c_str(), ui.c_str(), "--read-only", pane.c_str(), nullptr);
+	}
+	else
+	{
+		::execl(ui.c_str(), ui.c_str(), pane.c_str(), nullptr);
+	}
+	return 1;
+}
+
+int runSession(int daemon, const std::filesystem::path& ui, const std::string& pane)
+{
+	if (::pipe2(winchPipe, O_CLOEXEC | O_NONBLOCK) != 0 || !server::sendLine(daemon, "session " + pane, { STDIN_FILENO, STDOUT_FILENO }))
+	{
+		return 1;
+	}
+	std::signal(SIGWINCH, onWinch);
+
+	while (true)
+	{
+		pollfd watched[2] = { { daemon, POLLIN, 0 }, { winchPipe[0], POLLIN, 0 } };
+		if (::poll(watched, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 1;
+		}
+
+		if (watched[1].revents & POLLIN)
+		{
+			char drained[16];
+			while (::read(winchPipe[0], drained, sizeof(drained)) > 0)
+			{ }
+			server::sendLine(daemon, "winch");
+		}
+
+		if (watched[0].revents)
+		{
+			std::string answer;
+			if (!server::receiveLine(daemon, answer))
+			{
+				return 1;
+			}
+			if (answer == "busy")
+			{
+				::close(daemon);
+				return runStandalone(ui, pane, true);
+			}
+			return answer == "done" ? 0 : 1;
+		}
+	}
+}
+
+// The daemon closes the connection after answering, so the answer is everything up to EOF.
+// A list ends with an "end" line, which is not printed.
+int printAnswer(int daemon)
+{
+	std::string answer;
+	char buffer[64 * 1024];
+	for (ssize_t received; (received = ::read(daemon, buffer, sizeof(buffer))) != 0;)
+	{
+		if (received < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return 1;
+		}
+		answer.append(buffer, received);
+	}
+
+	if (answer == "busy\n")
+	{
+		std::fprintf(stderr, "tmux-snippets daemon is busy with another session\n");
+		return 1;
+	}
+	if (answer.starts_with("error"))
+	{
+		std::fprintf(stderr, "%s", answer.c_str());
+		return 1;
+	}
+	if (answer.ends_with("end\n"))
+	{
+		std::fwrite(answer.data(), 1, answer.size() - 4, stdout);
+	}
+	return answer.empty() ? 1 : 0;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s <pane> | --list [folder] | --send <uuid> <pane> [name=value ...] | --quit\n", argv[0]);
+		return 2;
+	}
+
+	auto ui = std::filesystem::path(argv[0]).parent_path() / "tmux-snippets-ui";
+	std::string mode(argv[1]);
+
+	int daemon = connectOrStart(ui);
+	if (daemon < 0)
+	{
+		if (mode.starts_with("--"))
+		{
+			std::fprintf(stderr, "tmux-snippets daemon is not reachable\n");
+			return 1;
+		}
+
+		return runStandalone(ui, mode);
+	}
+
+	if (mode == "--list")
+	{
+		server::sendLine(daemon, argc > 2 ? "list " + std::string(argv[2]) : "list");
+		return printAnswer(daemon);
+	}
+	if (mode == "--send" && argc > 3)
+	{
+		std::string request = "send " + std::string(argv[2]) + " " + argv[3];
+		for (int i = 4; i < argc; i++)
+		{
+			request += " " + std::string(argv[i]);
+		}
+		server::sendLine(daemon, request);
+		return printAnswer(daemon);
+	}
+	if (mode == "--quit")
+	{
+		server::sendLine(daemon, "quit");
+		return printAnswer(daemon);
+	}
+
+	return runSession(daemon, ui, mode);
+}
\ No newline at end of file
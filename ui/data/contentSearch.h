@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/storage.h"
+
+namespace data
+{
+
+// Search over snippet contents, as each storage backend provides it
+class contentSearch
+{
+public:
+	virtual ~contentSearch() = default;
+
+	// Case-insensitive substring search over contents
+	virtual std::vector<storage::snippet_shared_ptr_t> findSubstring(std::string_view needle, size_t limit) = 0;
+	// ECMAScript regex, case-insensitive; an invalid pattern finds nothing
+	virtual std::vector<storage::snippet_shared_ptr_t> findRegex(const std::string& pattern, size_t limit) = 0;
+};
+
+} // namespace data
\ No newline at end of file
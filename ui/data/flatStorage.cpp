@@ -0,0 +1,301 @@
+#include "data/flatStorage.h"
+
+namespace data
+{
+
+flatStorage::flatStorage()
+{
+	auto rootIndex = allocateFolder();
+	folders_[rootIndex].name_ = "/";
+	folders_[rootIndex].uuid_ = utils::generate_uuid();
+	folderIndex_[folders_[rootIndex].uuid_] = rootIndex;
+	currentFolder_ = rootIndex;
+}
+
+void flatStorage::setRoot()
+{
+	currentFolder_ = root();
+}
+
+void flatStorage::folderUp()
+{
+	if (!curIsRoot() && folders_[currentFolder_].parent_ != npos)
+	{
+		currentFolder_ = folders_[currentFolder_].parent_;
+	}
+}
+
+void flatStorage::folderDown(const uuids::uuid& uuid)
+{
+	auto found = findFolder(uuid);
+	if (found != npos && folders_[found].parent_ == currentFolder_)
+	{
+		currentFolder_ = found;
+	}
+}
+
+uuids::uuid flatStorage::addFolder(std::string_view name)
+{
+	return folders_[insertFolder(currentFolder_, name, utils::generate_uuid(utils::uuid_kind::time_ordered))].uuid_;
+}
+
+uuids::uuid flatStorage::addSnippet(std::string_view title, std::string_view content, bool from_file)
+{
+	return snippets_[insertSnippet(currentFolder_, title, content, utils::generate_uuid(utils::uuid_kind::time_ordered), from_file)].uuid;
+}
+
+uuids::uuid flatStorage::addSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file)
+{
+	return snippets_[insertSnippet(currentFolder_, title, content, uuid, from_file)].uuid;
+}
+
+void flatStorage::deleteFolder(const uuids::uuid& uuid)
+{
+	auto found = findFolder(uuid);
+	if (found == npos || found == root())
+	{
+		return;
+	}
+
+	// Do not leave the user inside a folder that no longer exists
+	for (auto i = currentFolder_; i != npos; i = folders_[i].parent_)
+	{
+		if (i == found)
+		{
+			currentFolder_ = folders_[found].parent_;
+			break;
+		}
+	}
+
+	unlinkFolder(found);
+	releaseFolder(found);
+}
+
+void flatStorage::deleteSnippet(const uuids::uuid& uuid)
+{
+	auto found = findSnippet(uuid);
+	if (found == npos)
+	{
+		return;
+	}
+
+	unlinkSnippet(found);
+	snippetIndex_.erase(uuid);
+	snippets_[found] = snippet {};
+	freeSnippets_.push_back(found);
+}
+
+void flatStorage::renameFolder(const uuids::uuid& uuid, std::string_view newName)
+{
+	auto found = findFolder(uuid);
+	if (found != npos)
+	{
+		folders_[found].name_ = strings_.intern(newName);
+	}
+}
+
+void flatStorage::editSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file)
+{
+	auto found = findSnippet(uuid);
+	if (found != npos)
+	{
+		auto& node = snippets_[found];
+		if (node.content != content)
+		{
+			node.content = strings_.store(content);
+		}
+		node.title = strings_.intern(title);
+		node.from_file = from_file;
+	}
+}
+
+flatStorage::index_t flatStorage::findFolder(const uuids::uuid& uuid) const
+{
+	auto it = folderIndex_.find(uuid);
+	return it == folderIndex_.end() ? npos : it->second;
+}
+
+flatStorage::index_t flatStorage::findSnippet(const uuids::uuid& uuid) const
+{
+	auto it = snippetIndex_.find(uuid);
+	return it == snippetIndex_.end() ? npos : it->second;
+}
+
+flatStorage::index_t flatStorage::insertFolder(index_t parent, std::string_view name, uuids::uuid uuid)
+{
+	while (folderIndex_.contains(uuid))
+	{
+		uuid = utils::generate_uuid();
+	}
+
+	auto index = allocateFolder();
+	auto& node = folders_[index];
+	node.name_ = strings_.intern(name);
+	node.uuid_ = uuid;
+	node.parent_ = parent;
+
+	auto& owner = folders_[parent];
+	node.prevSibling_ = owner.lastChild_;
+	if (owner.lastChild_ != npos)
+	{
+		folders_[owner.lastChild_].nextSibling_ = index;
+	}
+	else
+	{
+		owner.firstChild_ = index;
+	}
+	owner.lastChild_ = index;
+
+	folderIndex_[uuid] = index;
+	return index;
+}
+
+flatStorage::index_t flatStorage::insertSnippet(index_t parent, std::string_view title, std::string_view content, uuids::uuid uuid, bool from_file)
+{
+	while (snippetIndex_.contains(uuid))
+	{
+		uuid = utils::generate_uuid();
+	}
+
+	auto index = allocateSnippet();
+	auto& node = snippets_[index];
+	node.title = strings_.intern(title);
+	node.content = strings_.store(content);
+	node.uuid = uuid;
+	node.from_file = from_file;
+	node.parent = parent;
+
+	auto& owner = folders_[parent];
+	node.prevSibling = owner.lastSnippet_;
+	if (owner.lastSnippet_ != npos)
+	{
+		snippets_[owner.lastSnippet_].nextSibling = index;
+	}
+	else
+	{
+		owner.firstSnippet_ = index;
+	}
+	owner.lastSnippet_ = index;
+
+	snippetIndex_[uuid] = index;
+	return index;
+}
+
+void flatStorage::reserve(size_t folders, size_t snippets)
+{
+	folders_.reserve(folders + 1);
+	snippets_.reserve(snippets);
+	folderIndex_.reserve(folders + 1);
+	snippetIndex_.reserve(snippets);
+}
+
+flatStorage::index_t flatStorage::allocateFolder()
+{
+	if (!freeFolders_.empty())
+	{
+		auto index = freeFolders_.back();
+		freeFolders_.pop_back();
+		return index;
+	}
+
+	folders_.emplace_back();
+	return static_cast<index_t>(folders_.size() - 1);
+}
+
+flatStorage::index_t flatStorage::allocateSnippet()
+{
+	if (!freeSnippets_.empty())
+	{
+		auto index = freeSnippets_.back();
+		freeSnippets_.pop_back();
+		return index;
+	}
+
+	snippets_.emplace_back();
+	return static_cast<index_t>(snippets_.size() - 1);
+}
+
+void flatStorage::unlinkFolder(index_t index)
+{
+	auto& node = folders_[index];
+	auto& owner = folders_[node.parent_];
+
+	if (node.prevSibling_ != npos)
+	{
+		folders_[node.prevSibling_].nextSibling_ = node.nextSibling_;
+	}
+	else
+	{
+		owner.firstChild_ = node.nextSibling_;
+	}
+
+	if (node.nextSibling_ != npos)
+	{
+		folders_[node.nextSibling_].prevSibling_ = node.prevSibling_;
+	}
+	else
+	{
+		owner.lastChild_ = node.prevSibling_;
+	}
+
+	node.prevSibling_ = npos;
+	node.nextSibling_ = npos;
+}
+
+void flatStorage::unlinkSnippet(index_t index)
+{
+	auto& node = snippets_[index];
+	auto& owner = folders_[node.parent];
+
+	if (node.prevSibling != npos)
+	{
+		snippets_[node.prevSibling].nextSibling = node.nextSibling;
+	}
+	else
+	{
+		owner.firstSnippet_ = node.nextSibling;
+	}
+
+	if (node.nextSibling != npos)
+	{
+		snippets_[node.nextSibling].prevSibling = node.prevSibling;
+	}
+	else
+	{
+		owner.lastSnippet_ = node.prevSibling;
+	}
+
+	node.prevSibling = npos;
+	node.nextSibling = npos;
+}
+
+void flatStorage::releaseFolder(index_t index)
+{
+	// Iterative walk over the detached subtree, so deep trees cannot overflow the stack
+	std::vector<index_t> pending { index };
+	while (!pending.empty())
+	{
+		auto current = pending.back();
+		pending.pop_back();
+
+		for (auto i = folders_[current].firstSnippet_; i != npos;)
+		{
+			auto next = snippets_[i].nextSibling;
+			snippetIndex_.erase(snippets_[i].uuid);
+			snippets_[i] = snippet {};
+			freeSnippets_.push_back(i);
+			i = next;
+		}
+
+		for (auto i = folders_[current].firstChild_; i != npos; i = folders_[i].nextSibling_)
+		{
+			pending.push_back(i);
+		}
+
+		folderIndex_.erase(folders_[current].uuid_);
+		folders_[current] = folder {};
+		freeFolders_.push_back(current);
+	}
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/stringArena.h"
+#include "utils/generate_uuid.h"
+
+namespace data
+{
+
+// Same tree as data::storage, but every folder and snippet lives in one of two flat vectors
+// and nodes refer to each other by 32-bit indices instead of shared/weak pointers.
+class flatStorage
+{
+public:
+	using shared_ptr_t = std::shared_ptr<flatStorage>;
+	using index_t = std::uint32_t;
+
+	static constexpr index_t npos = std::numeric_limits<index_t>::max();
+
+	struct snippet
+	{
+		std::string_view title;
+		std::string_view content;
+		uuids::uuid uuid;
+		index_t parent { npos };
+		index_t prevSibling { npos };
+		index_t nextSibling { npos };
+		bool from_file { false };
+	};
+
+	struct folder
+	{
+		std::string_view name_;
+		uuids::uuid uuid_;
+		index_t parent_ { npos };
+		index_t prevSibling_ { npos };
+		index_t nextSibling_ { npos };
+		index_t firstChild_ { npos };
+		index_t lastChild_ { npos };
+		index_t firstSnippet_ { npos };
+		index_t lastSnippet_ { npos };
+	};
+
+	flatStorage();
+
+	index_t root() const { return 0; }
+
+	index_t currentFolder() const { return currentFolder_; }
+
+	bool curIsRoot() const { return currentFolder_ == root(); }
+
+	void setRoot();
+
+	void folderUp();
+	void folderDown(const uuids::uuid& uuid);
+
+	uuids::uuid addFolder(std::string_view name);
+	uuids::uuid addSnippet(std::string_view title, std::string_view content, bool from_file = false);
+	uuids::uuid addSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file = false);
+
+	void deleteFolder(const uuids::uuid& uuid);
+	void deleteSnippet(const uuids::uuid& uuid);
+
+	void renameFolder(const uuids::uuid& uuid, std::string_view newName);
+	void editSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file = false);
+
+	index_t findFolder(const uuids::uuid& uuid) const;
+	index_t findSnippet(const uuids::uuid& uuid) const;
+
+	const folder& folderAt(index_t index) const { return folders_[index]; }
+
+	const snippet& snippetAt(index_t index) const { return snippets_[index]; }
+
+	size_t folderCount() const { return folderIndex_.size(); }
+
+	size_t snippetCount() const { return snippetIndex_.size(); }
+
+	// Loader entry points: append a node under an arbitrary parent, keeping child order.
+	// Strings are copied into the storage arena, names and titles are interned.
+	index_t insertFolder(index_t parent, std::string_view name, uuids::uuid uuid = utils::generate_uuid());
+	index_t insertSnippet(index_t parent, std::string_view title, std::string_view content, uuids::uuid uuid = utils::generate_uuid(), bool from_file = false);
+
+	void reserve(size_t folders, size_t snippets);
+
+	const stringArena& strings() const { return strings_; }
+
+	template<typename Func>
+	void forEachSubFolder(index_t parent, Func&& func) const
+	{
+		for (index_t i = folders_[parent].firstChild_; i != npos; i = folders_[i].nextSibling_)
+		{
+			func(i, folders_[i]);
+		}
+	}
+
+	template<typename Func>
+	void forEachSnippet(index_t parent, Func&& func) const
+	{
+		for (index_t i = folders_[parent].firstSnippet_; i != npos; i = snippets_[i].nextSibling)
+		{
+			func(i, snippets_[i]);
+		}
+	}
+
+private:
+	index_t allocateFolder();
+	index_t allocateSnippet();
+
+	void unlinkFolder(index_t index);
+	void unlinkSnippet(index_t index);
+	void releaseFolder(index_t index);
+
+	stringArena strings_;
+
+	std::vector<folder> folders_;
+	std::vector<snippet> snippets_;
+
+	// Slots of deleted nodes, reused by the next insert
+	std::vector<index_t> freeFolders_;
+	std::vector<index_t> freeSnippets_;
+
+	std::unordered_map<uuids::uuid, index_t> folderIndex_;
+	std::unordered_map<uuids::uuid, index_t> snippetIndex_;
+
+	index_t currentFolder_ { 0 };
+};
+
+} // namespace data
\ No newline at end of file
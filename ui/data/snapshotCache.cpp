@@ -0,0 +1,415 @@
+#include "data/snapshotCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace data
+{
+namespace
+{
+constexpr char snapshotMagic[8] = { 'T', 'M', 'X', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t snapshotVersion = 2;
+constexpr uint32_t noParent = UINT32_MAX;
+constexpr uint32_t fromFileFlag = 1;
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t folderCount;
+	uint32_t snippetCount;
+	uint32_t rootSnippets;
+	uint64_t xmlSize;
+	int64_t xmlMtime;
+	uint64_t stringsSize;
+};
+
+// Folders are stored in preorder: the subtree of folder i is [i + 1, subtreeEnd)
+struct folderRecord
+{
+	uint8_t uuid[16];
+	uint32_t parent;
+	uint32_t name;
+	uint32_t subtreeEnd;
+	uint32_t firstSnippet;
+	uint32_t snippetCount;
+	uint32_t reserved;
+};
+
+// Snippets of one folder are contiguous; the root ones come first
+struct snippetRecord
+{
+	uint8_t uuid[16];
+	uint32_t folder;
+	uint32_t flags;
+	uint32_t title;
+	uint32_t content;
+};
+
+static_assert(sizeof(header) == 48 && sizeof(folderRecord) == 40 && sizeof(snippetRecord) == 32, "snapshot records must not contain padding");
+
+template<typename T>
+T readRecord(const char* at)
+{
+	T value;
+	std::memcpy(&value, at, sizeof(T));
+	return value;
+}
+
+uuids::uuid toUuid(const uint8_t (&bytes)[16])
+{
+	return uuids::uuid(std::begin(bytes), std::end(bytes));
+}
+
+void fromUuid(const uuids::uuid& uuid, uint8_t (&bytes)[16])
+{
+	std::memcpy(bytes, uuid.as_bytes().data(), sizeof(bytes));
+}
+
+class snapshotWriter
+{
+public:
+	// Image folder i + 1 becomes snapshot folder i, the root is not stored as a record
+	void collect(const storageImage& image)
+	{
+		auto toRecordIndex = [](uint32_t index) { return index == 0 ? noParent : index - 1; };
+
+		for (uint32_t i = 0; i < image.folders.size(); i++)
+		{
+			const auto& folder = image.folders[i];
+			if (i == 0)
+			{
+				rootSnippets_ = folder.snippetCount;
+			}
+			else
+			{
+				folderRecord record {};
+				fromUuid(folder.uuid, record.uuid);
+				record.parent = toRecordIndex(folder.parent);
+				record.name = addString(folder.name);
+				record.subtreeEnd = folder.subtreeEnd - 1;
+				record.firstSnippet = folder.firstSnippet;
+				record.snippetCount = folder.snippetCount;
+				folders_.push_back(record);
+			}
+
+			for (uint32_t j = folder.firstSnippet; j < folder.firstSnippet + folder.snippetCount; j++)
+			{
+				const auto& snippet = image.snippets[j];
+				snippetRecord record {};
+				fromUuid(snippet.uuid, record.uuid);
+				record.folder = toRecordIndex(i);
+				record.flags = snippet.from_file ? fromFileFlag : 0;
+				record.title = addString(snippet.title);
+				record.content = addString(snippet.content());
+				snippets_.push_back(record);
+			}
+		}
+	}
+
+	bool save(const std::filesystem::path& path, const snapshotCache::fileStamp& xmlStamp) const
+	{
+		header head {};
+		std::memcpy(head.magic, snapshotMagic, sizeof(snapshotMagic));
+		head.version = snapshotVersion;
+		head.folderCount = static_cast<uint32_t>(folders_.size());
+		head.snippetCount = static_cast<uint32_t>(snippets_.size());
+		head.rootSnippets = rootSnippets_;
+		head.xmlSize = xmlStamp.size;
+		head.xmlMtime = xmlStamp.mtime;
+		head.stringsSize = strings_.size();
+
+		// Written aside and renamed, so a reader never maps a half written file
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+			out.write(reinterpret_cast<const char*>(folders_.data()), folders_.size() * sizeof(folderRecord));
+			out.write(reinterpret_cast<const char*>(snippets_.data()), snippets_.size() * sizeof(snippetRecord));
+			out.write(strings_.data(), strings_.size());
+			if (!out.good())
+			{
+				std::error_code ec;
+				std::filesystem::remove(tmpPath, ec);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmpPath, path, ec);
+		return !ec;
+	}
+
+private:
+	uint32_t addString(std::string_view value)
+	{
+		// Titles and folder names repeat a lot, keep one copy of each
+		if (auto it = offsets_.find(value); it != offsets_.end())
+		{
+			return it->second;
+		}
+
+		auto offset = static_cast<uint32_t>(strings_.size());
+		auto length = static_cast<uint32_t>(value.size());
+		strings_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		strings_.append(value);
+		strings_.push_back('\0');
+
+		offsets_.emplace(value, offset);
+		return offset;
+	}
+
+	std::vector<folderRecord> folders_;
+	std::vector<snippetRecord> snippets_;
+	uint32_t rootSnippets_ { 0 };
+	std::string strings_;
+	// Keys point into the image being written, which outlives the writer
+	std::unordered_map<std::string_view, uint32_t> offsets_;
+};
+
+// Owns the mapping. Serves lazy snippet bodies (handle = string offset) and fills
+// placeholder folders one level at a time (handle = folder record index).
+// check() goes over every record once before anything is built, so populating can trust them.
+class snapshotReader
+: public storage::contentSource
+, public storage::subtreeSource
+{
+public:
+	snapshotReader(std::shared_ptr<const void> mapping, const char* base, const header& head, bool lazyContent)
+	: mapping_(std::move(mapping))
+	, folders_(base + sizeof(header))
+	, snippets_(folders_ + uint64_t(head.folderCount) * sizeof(folderRecord))
+	, strings_(snippets_ + uint64_t(head.snippetCount) * sizeof(snippetRecord))
+	, folderCount_(head.folderCount)
+	, snippetCount_(head.snippetCount)
+	, rootSnippets_(head.rootSnippets)
+	, stringsSize_(head.stringsSize)
+	, lazyContent_(lazyContent)
+	{ }
+
+	std::string_view resolve(uint64_t handle) const override
+	{
+		if (handle > UINT32_MAX || !valid(static_cast<uint32_t>(handle)))
+		{
+			return {};
+		}
+		return at(static_cast<uint32_t>(handle));
+	}
+
+	void populate(storage& target, const storage::folder_shared_ptr_t& placeholder, uint64_t handle) const override
+	{
+		if (handle >= folderCount_)
+		{
+			return;
+		}
+		auto index = static_cast<uint32_t>(handle);
+		auto record = readRecord<folderRecord>(folders_ + index * sizeof(folderRecord));
+		populate(target, placeholder, index, record.firstSnippet, record.snippetCount, index + 1, record.subtreeEnd);
+	}
+
+	// The folders must nest as a preorder with their parents and subtree ends agreeing, the
+	// snippet ranges must follow each other in that order and every string must be in the blob
+	bool check() const
+	{
+		uint32_t nextSnippet = rootSnippets_;
+		if (!checkSnippets(noParent, 0, rootSnippets_))
+		{
+			return false;
+		}
+
+		// Folders whose subtree is still open at the current record, innermost last
+		std::vector<std::pair<uint32_t, uint32_t>> open;
+		for (uint32_t i = 0; i < folderCount_; i++)
+		{
+			while (!open.empty() && open.back().second <= i)
+			{
+				open.pop_back();
+			}
+
+			auto record = readRecord<folderRecord>(folders_ + i * sizeof(folderRecord));
+			auto parent = open.empty() ? noParent : open.back().first;
+			auto parentEnd = open.empty() ? folderCount_ : open.back().second;
+			if (record.parent != parent || record.subtreeEnd <= i || record.subtreeEnd > parentEnd || !valid(record.name)
+				|| record.firstSnippet != nextSnippet || !checkSnippets(i, record.firstSnippet, record.snippetCount))
+			{
+				return false;
+			}
+
+			nextSnippet += record.snippetCount;
+			open.emplace_back(i, record.subtreeEnd);
+		}
+		return nextSnippet == snippetCount_;
+	}
+
+	void populateRoot(storage& target) const
+	{
+		populate(target, target.root(), noParent, 0, rootSnippets_, 0, folderCount_);
+	}
+
+private:
+	bool checkSnippets(uint32_t folder, uint32_t firstSnippet, uint32_t snippetCount) const
+	{
+		if (uint64_t(firstSnippet) + snippetCount > snippetCount_)
+		{
+			return false;
+		}
+		for (auto i = firstSnippet; i < firstSnippet + snippetCount; i++)
+		{
+			auto record = readRecord<snippetRecord>(snippets_ + i * sizeof(snippetRecord));
+			if (record.folder != folder || !valid(record.title) || !valid(record.content))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void populate(storage& target, const storage::folder_shared_ptr_t& folder, uint32_t index, uint32_t firstSnippet, uint32_t snippetCount, uint32_t childBegin,
+		uint32_t childEnd) const
+	{
+		for (auto i = firstSnippet; i < firstSnippet + snippetCount; i++)
+		{
+			auto record = readRecord<snippetRecord>(snippets_ + i * sizeof(snippetRecord));
+			bool fromFile = (record.flags & fromFileFlag) != 0;
+			if (lazyContent_)
+			{
+				target.insertSnippet(folder, std::make_shared<storage::snippet_t>(at(record.title), std::string_view {}, toUuid(record.uuid), fromFile, this, record.content));
+			}
+			else
+			{
+				target.insertSnippet(folder, std::make_shared<storage::snippet_t>(at(record.title), at(record.content), toUuid(record.uuid), fromFile));
+			}
+		}
+
+		for (auto i = childBegin; i < childEnd;)
+		{
+			auto record = readRecord<folderRecord>(folders_ + i * sizeof(folderRecord));
+			auto placeholder = std::make_shared<storage::folder>(at(record.name), toUuid(record.uuid));
+			placeholder->source_ = this;
+			placeholder->handle_ = i;
+			target.insertFolder(folder, placeholder);
+			i = record.subtreeEnd;
+		}
+	}
+
+	bool valid(uint32_t offset) const
+	{
+		if (uint64_t(offset) + sizeof(uint32_t) > stringsSize_)
+		{
+			return false;
+		}
+		auto length = readRecord<uint32_t>(strings_ + offset);
+		return uint64_t(offset) + sizeof(uint32_t) + length + 1 <= stringsSize_;
+	}
+
+	std::string_view at(uint32_t offset) const
+	{
+		auto length = readRecord<uint32_t>(strings_ + offset);
+		return { strings_ + offset + sizeof(uint32_t), length };
+	}
+
+	std::shared_ptr<const void> mapping_;
+	const char* folders_;
+	const char* snippets_;
+	const char* strings_;
+	uint32_t folderCount_;
+	uint32_t snippetCount_;
+	uint32_t rootSnippets_;
+	uint64_t stringsSize_;
+	bool lazyContent_;
+};
+} // namespace
+
+std::filesystem::path snapshotCache::pathFor(const std::filesystem::path& xmlPath)
+{
+	auto path = xmlPath;
+	path += ".snapshot";
+	return path;
+}
+
+std::optional<snapshotCache::fileStamp> snapshotCache::stampOf(const std::filesystem::path& path)
+{
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+	{
+		return std::nullopt;
+	}
+	return fileStamp { static_cast<uint64_t>(st.st_size), int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec };
+}
+
+bool snapshotCache::load(const std::filesystem::path& xmlPath, const fileStamp& xmlStamp, storage& target, bool lazyContent, bool lazySubtrees)
+{
+	int fd = ::open(pathFor(xmlPath).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(header))
+	{
+		::close(fd);
+		return false;
+	}
+
+	auto fileSize = static_cast<size_t>(st.st_size);
+	void* address = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+
+	std::shared_ptr<const void> mapping(address, [fileSize](const void* ptr) { ::munmap(const_cast<void*>(ptr), fileSize); });
+	const auto* base = static_cast<const char*>(address);
+
+	auto head = readRecord<header>(base);
+	if (std::memcmp(head.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || head.version != snapshotVersion || head.xmlSize != xmlStamp.size
+		|| head.xmlMtime != xmlStamp.mtime)
+	{
+		return false;
+	}
+
+	if (sizeof(header) + uint64_t(head.folderCount) * sizeof(folderRecord) + uint64_t(head.snippetCount) * sizeof(snippetRecord) + head.stringsSize != fileSize
+		|| head.rootSnippets > head.snippetCount)
+	{
+		return false;
+	}
+
+	// A damaged record rejects the whole snapshot: a partial tree would be saved over the xml
+	auto reader = std::make_shared<snapshotReader>(std::move(mapping), base, head, lazyContent);
+	if (!reader->check())
+	{
+		return false;
+	}
+
+	// Only the root level is built now, the other folders are filled when they are entered
+	reader->populateRoot(target);
+	if (!lazySubtrees)
+	{
+		target.loadAll();
+	}
+
+	// The reader owns the mapping that every title, name and body points into
+	target.retainBuffer(std::move(reader));
+	return true;
+}
+
+bool snapshotCache::write(const std::filesystem::path& xmlPath, const storageImage& source, const fileStamp& xmlStamp)
+{
+	snapshotWriter writer;
+	writer.collect(source);
+	return writer.save(pathFor(xmlPath), xmlStamp);
+}
+
+} // namespace data
\ No newline at end of file
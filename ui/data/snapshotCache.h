@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "data/storage.h"
+#include "data/storageImage.h"
+
+namespace data
+{
+
+// Binary copy of storage.xml kept next to it (storage.xml.snapshot) so startup can skip
+// the xml parser. The snapshot is only trusted while the stamp of the xml files (size and
+// mtime, see xmlStorageManager::stampOf) matches the one recorded when it was written.
+//
+// Layout: header, folder records (preorder, each with its subtree end and snippet range),
+// snippet records grouped by folder, then a blob of length-prefixed, NUL-terminated strings.
+// Loaded snapshots are mmap-ed and the storage points straight into the mapping.
+class snapshotCache
+{
+public:
+	struct fileStamp
+	{
+		uint64_t size { 0 };
+		int64_t mtime { 0 };
+	};
+
+	static std::filesystem::path pathFor(const std::filesystem::path& xmlPath);
+	static std::optional<fileStamp> stampOf(const std::filesystem::path& path);
+
+	// Fills an empty storage from the snapshot of xml files that currently have the given stamp.
+	// Returns false, leaving the storage untouched, when there is no snapshot, it is stale or
+	// any of its records is damaged. With lazyContent the snippet bodies are not read until
+	// they are first used; with lazySubtrees only the root level is built and the other
+	// folders are placeholders.
+	static bool load(const std::filesystem::path& xmlPath, const fileStamp& xmlStamp, storage& target, bool lazyContent = true, bool lazySubtrees = true);
+
+	// Writes the snapshot for an xml file that currently has the given stamp.
+	// Safe to call off the storage thread: only the image is read.
+	static bool write(const std::filesystem::path& xmlPath, const storageImage& source, const fileStamp& xmlStamp);
+};
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "data/snippetSearch.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace data
+{
+namespace
+{
+constexpr size_t notFound = SIZE_MAX;
+// The scanner reads whole 16-byte blocks, the last title must not be the end of the buffer
+constexpr size_t scanPadding = 16;
+
+constexpr int matchScore = 16;
+constexpr int consecutiveBonus = 24;
+constexpr int wordStartBonus = 20;
+constexpr int maxGapPenalty = 10;
+constexpr int maxLeadPenalty = 15;
+
+char toLower(char ch)
+{
+	return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+bool isWordStart(const char* title, size_t pos)
+{
+	if (pos == 0)
+	{
+		return true;
+	}
+	auto prev = title[pos - 1];
+	return prev == ' ' || prev == '-' || prev == '_' || prev == '/' || prev == '.' || prev == ':';
+}
+
+// Letters and digits get a bit of their own, everything else shares the rest
+uint64_t charBit(char ch)
+{
+	auto byte = static_cast<unsigned char>(ch);
+	if (byte >= 'a' && byte <= 'z')
+	{
+		return uint64_t(1) << (byte - 'a');
+	}
+	if (byte >= '0' && byte <= '9')
+	{
+		return uint64_t(1) << (26 + byte - '0');
+	}
+	return uint64_t(1) << (36 + byte % 28);
+}
+
+// First position of `ch` in [from, end); the buffer stays readable for scanPadding bytes past end
+size_t findByte(const char* data, size_t from, size_t end, char ch)
+{
+#if defined(__SSE2__)
+	auto needle = _mm_set1_epi8(ch);
+	for (size_t i = from; i < end; i += 16)
+	{
+		auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+		if (mask)
+		{
+			auto pos = i + std::countr_zero(mask);
+			return pos < end ? pos : notFound;
+		}
+	}
+	return notFound;
+#else
+	auto found = static_cast<const char*>(std::memchr(data + from, ch, end - from));
+	return found ? static_cast<size_t>(found - data) : notFound;
+#endif
+}
+} // namespace
+
+void snippetSearch::refresh(storage& source)
+{
+	source.loadAll();
+	if (built_ && generation_ == source.generation())
+	{
+		return;
+	}
+
+	entries_.clear();
+	haystack_.clear();
+
+	// Tree order: snippets of a folder, then its subfolders
+	std::vector<storage::folder_shared_ptr_t> pending { source.root() };
+	while (!pending.empty())
+	{
+		auto current = std::move(pending.back());
+		pending.pop_back();
+
+		for (const auto& snippet : current->snippets_)
+		{
+			entry item { snippet, static_cast<uint32_t>(haystack_.size()), static_cast<uint32_t>(snippet->title.size()), 0 };
+			for (auto ch : snippet->title)
+			{
+				auto lower = toLower(ch);
+				haystack_.push_back(lower);
+				item.characters |= charBit(lower);
+			}
+			entries_.push_back(std::move(item));
+		}
+
+		for (auto it = current->subFolders_.rbegin(); it != current->subFolders_.rend(); ++it)
+		{
+			pending.push_back(*it);
+		}
+	}
+	haystack_.append(scanPadding, '\0');
+
+	generation_ = source.generation();
+	built_ = true;
+
+	levels_.assign(1, {});
+	levels_[0].reserve(entries_.size());
+	for (uint32_t i = 0; i < entries_.size(); i++)
+	{
+		levels_[0].push_back({ i, 0, 0 });
+	}
+
+	// Re-run the current query against the new titles
+	auto query = std::move(query_);
+	query_.clear();
+	setQuery(query);
+}
+
+void snippetSearch::setQuery(std::string_view query, size_t limit)
+{
+	size_t common = 0;
+	while (common < query.size() && common < query_.size() && toLower(query[common]) == query_[common])
+	{
+		common++;
+	}
+
+	levels_.resize(common + 1);
+	query_.resize(common);
+	for (size_t i = common; i < query.size(); i++)
+	{
+		query_.push_back(toLower(query[i]));
+		extend(query_.back());
+	}
+
+	rank(limit);
+}
+
+void snippetSearch::extend(char ch)
+{
+	const auto& previous = levels_.back();
+	std::vector<candidate> next;
+	next.reserve(previous.size());
+
+	auto bit = charBit(ch);
+	bool first = levels_.size() == 1;
+	const auto* data = haystack_.data();
+
+	for (const auto& current : previous)
+	{
+		const auto& item = entries_[current.entry];
+		if (!(item.characters & bit))
+		{
+			continue;
+		}
+
+		auto pos = findByte(data, item.offset + current.next, item.offset + item.length, ch);
+		if (pos == notFound)
+		{
+			continue;
+		}
+
+		auto relative = static_cast<uint32_t>(pos - item.offset);
+		int score = current.score + matchScore;
+		if (first)
+		{
+			score -= std::min<int>(relative, maxLeadPenalty);
+		}
+		else if (relative == current.next)
+		{
+			score += consecutiveBonus;
+		}
+		else
+		{
+			score -= std::min<int>(relative - current.next, maxGapPenalty);
+		}
+		if (isWordStart(data + item.offset, relative))
+		{
+			score += wordStartBonus;
+		}
+
+		next.push_back({ current.entry, relative + 1, score });
+	}
+
+	levels_.push_back(std::move(next));
+}
+
+void snippetSearch::rank(size_t limit)
+{
+	auto ranked = levels_.back();
+	auto better = [this](const candidate& left, const candidate& right)
+	{
+		if (left.score != right.score)
+		{
+			return left.score > right.score;
+		}
+		if (entries_[left.entry].length != entries_[right.entry].length)
+		{
+			return entries_[left.entry].length < entries_[right.entry].length;
+		}
+		return left.entry < right.entry;
+	};
+
+	auto count = std::min(limit, ranked.size());
+	if (!query_.empty())
+	{
+		std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+	}
+
+	results_.clear();
+	results_.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		results_.push_back({ entries_[ranked[i].entry].snippet, ranked[i].score });
+	}
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/storage.h"
+
+namespace data
+{
+
+// Type-to-filter over the titles of every snippet in the storage.
+//
+// A query matches a title when its characters appear in it in order (case-insensitive for
+// ASCII). Matches are scored like the usual fuzzy finders: consecutive characters, word
+// starts and an early first match score higher, gaps cost a little.
+//
+// Titles are copied once, lowercased, into one padded buffer that the SIMD scanner can read
+// in 16-byte blocks. Every query prefix keeps its candidate set with the greedy match state,
+// so a typed character only extends the matches of the previous set and a deleted one just
+// drops the last set.
+class snippetSearch
+{
+public:
+	struct result
+	{
+		storage::snippet_shared_ptr_t snippet;
+		int score;
+	};
+
+	// Takes every snippet of the storage (loads the placeholders) when the storage changed
+	// since the last call, or on the first one
+	void refresh(storage& source);
+
+	// Filters for the new query and ranks the matches; `limit` bounds the ranked results
+	void setQuery(std::string_view query, size_t limit = 200);
+
+	const std::string& query() const { return query_; }
+
+	// Best first; empty query gives the titles in tree order
+	const std::vector<result>& results() const { return results_; }
+
+	// Number of titles matching the query, ranked or not
+	size_t matchCount() const { return levels_.back().size(); }
+
+	size_t size() const { return entries_.size(); }
+
+private:
+	struct entry
+	{
+		storage::snippet_shared_ptr_t snippet;
+		uint32_t offset;
+		uint32_t length;
+		// Which characters occur in the title, see charBit()
+		uint64_t characters;
+	};
+
+	struct candidate
+	{
+		uint32_t entry;
+		// Position after the last matched character, relative to the title
+		uint32_t next;
+		int score;
+	};
+
+	void extend(char ch);
+	void rank(size_t limit);
+
+	std::vector<entry> entries_;
+	std::string haystack_;
+	uint64_t generation_ { 0 };
+	bool built_ { false };
+
+	std::string query_;
+	// levels_[i]: candidates matching the first i characters of the query
+	std::vector<std::vector<candidate>> levels_ { 1 };
+	std::vector<result> results_;
+};
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "data/snippetTemplate.h"
+
+namespace data
+{
+
+static bool isNameChar(char ch)
+{
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' || ch == '-';
+}
+
+snippetTemplate snippetTemplate::parse(std::string_view content)
+{
+	snippetTemplate result;
+	result.text_ = content;
+
+	size_t literalStart = 0;
+	auto pushLiteral = [&](size_t end)
+	{
+		if (end > literalStart)
+		{
+			result.segments_.push_back({ static_cast<uint32_t>(literalStart), static_cast<uint32_t>(end - literalStart), noVariable });
+		}
+	};
+
+	for (size_t open = content.find("{{"); open != std::string_view::npos; open = content.find("{{", open + 1))
+	{
+		// {{{{ stands for {{: the first pair stays in the literal, the second is dropped
+		if (content.substr(open, 4) == "{{{{")
+		{
+			pushLiteral(open + 2);
+			literalStart = open + 4;
+			open += 3;
+			result.hasEscapes_ = true;
+			continue;
+		}
+
+		size_t nameEnd = open + 2;
+		while (nameEnd < content.size() && isNameChar(content[nameEnd]))
+		{
+			nameEnd++;
+		}
+		if (nameEnd == open + 2 || nameEnd == content.size())
+		{
+			continue;
+		}
+
+		// {{name}} or {{name:default}}, the default on the same line
+		std::optional<std::string_view> defaultValue;
+		size_t close = nameEnd;
+		if (content[nameEnd] == ':')
+		{
+			close = content.find("}}", nameEnd + 1);
+			if (close == std::string_view::npos || content.substr(nameEnd + 1, close - nameEnd - 1).find('\n') != std::string_view::npos)
+			{
+				continue;
+			}
+			defaultValue = content.substr(nameEnd + 1, close - nameEnd - 1);
+		}
+		else if (content.substr(nameEnd, 2) != "}}")
+		{
+			continue;
+		}
+
+		auto name = content.substr(open + 2, nameEnd - open - 2);
+		uint32_t index = 0;
+		while (index < result.variables_.size() && result.variables_[index].name != name)
+		{
+			index++;
+		}
+		if (index == result.variables_.size())
+		{
+			result.variables_.push_back({ std::string(name), std::nullopt });
+		}
+		if (defaultValue && !result.variables_[index].defaultValue)
+		{
+			result.variables_[index].defaultValue = std::string(*defaultValue);
+		}
+
+		pushLiteral(open);
+		result.segments_.push_back({ 0, 0, index });
+		literalStart = close + 2;
+		open = close + 1;
+	}
+	pushLiteral(content.size());
+
+	return result;
+}
+
+std::string snippetTemplate::fill(const std::vector<std::string>& values) const
+{
+	auto valueOf = [&](uint32_t variable) -> std::string_view
+	{
+		if (variable < values.size())
+		{
+			return values[variable];
+		}
+		return variables_[variable].defaultValue ? std::string_view(*variables_[variable].defaultValue) : std::string_view {};
+	};
+
+	size_t size = 0;
+	for (const auto& segment : segments_)
+	{
+		size += segment.variable == noVariable ? segment.length : valueOf(segment.variable).size();
+	}
+
+	std::string result;
+	result.reserve(size);
+	for (const auto& segment : segments_)
+	{
+		if (segment.variable == noVariable)
+		{
+			result.append(text_, segment.offset, segment.length);
+		}
+		else
+		{
+			result.append(valueOf(segment.variable));
+		}
+	}
+	return result;
+}
+
+std::optional<std::string> snippetTemplate::fill(const std::unordered_map<std::string, std::string>& values, std::string* missing) const
+{
+	std::vector<std::string> ordered;
+	ordered.reserve(variables_.size());
+	for (const auto& variable : variables_)
+	{
+		if (auto found = values.find(variable.name); found != values.end())
+		{
+			ordered.push_back(found->second);
+		}
+		else if (variable.defaultValue)
+		{
+			ordered.push_back(*variable.defaultValue);
+		}
+		else
+		{
+			if (missing)
+			{
+				*missing = variable.name;
+			}
+			return std::nullopt;
+		}
+	}
+	return fill(ordered);
+}
+
+templateCache::templateCache(storage::shared_ptr_t source)
+: storage_(std::move(source))
+{
+	listenerId_ = storage_->addChangeListener([this](const storage::change& what) { onChange(what); });
+}
+
+templateCache::~templateCache()
+{
+	storage_->removeChangeListener(listenerId_);
+}
+
+templateCache::template_ptr_t templateCache::get(const storage::snippet_t& snippet)
+{
+	if (snippet.from_file)
+	{
+		return nullptr;
+	}
+
+	auto found = templates_.find(snippet.uuid);
+	if (found != templates_.end())
+	{
+		return found->second;
+	}
+
+	template_ptr_t parsed;
+	auto content = snippet.content();
+	if (content.find("{{") != std::string_view::npos)
+	{
+		auto candidate = std::make_shared<snippetTemplate>(snippetTemplate::parse(content));
+		if (candidate->changesContent())
+		{
+			parsed = std::move(candidate);
+		}
+	}
+	templates_.emplace(snippet.uuid, parsed);
+	return parsed;
+}
+
+void templateCache::onChange(const storage::change& what)
+{
+	switch (what.what)
+	{
+	case storage::change::kind::snippetEdited:
+	case storage::change::kind::snippetDeleted:
+		templates_.erase(what.uuid);
+		break;
+	case storage::change::kind::folderDeleted:
+		for (const auto& uuid : what.snippets)
+		{
+			templates_.erase(uuid);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+
+namespace data
+{
+
+// Content with placeholders: {{name}}, or {{name:default}} with the default up to the closing
+// braces. Names are letters, digits, '_' and '-'; any other {{...}} is kept as written, so
+// templates of other tools (Go, Jinja, Helm) pass through unchanged. A name used twice is one
+// variable. {{{{ is a literal {{, so {{{{name}} sends {{name}}.
+//
+// Parsed once into literal and variable segments; filling computes the size, then appends
+// every segment in one pass.
+class snippetTemplate
+{
+public:
+	struct variable
+	{
+		std::string name;
+		std::optional<std::string> defaultValue;
+	};
+
+	static snippetTemplate parse(std::string_view content);
+
+	bool hasVariables() const { return !variables_.empty(); }
+	// False when filling gives back the content as it is
+	bool changesContent() const { return hasVariables() || hasEscapes_; }
+	const std::vector<variable>& variables() const { return variables_; }
+
+	// values[i] is the value of variables()[i]
+	std::string fill(const std::vector<std::string>& values) const;
+
+	// Named values; variables without one take their default. Empty when one has neither,
+	// its name is then in missing.
+	std::optional<std::string> fill(const std::unordered_map<std::string, std::string>& values, std::string* missing = nullptr) const;
+
+private:
+	struct segment
+	{
+		uint32_t offset;
+		uint32_t length;
+		// Index into variables_, noVariable for literal text
+		uint32_t variable;
+	};
+	static constexpr uint32_t noVariable = UINT32_MAX;
+
+	std::string text_;
+	std::vector<segment> segments_;
+	std::vector<variable> variables_;
+	bool hasEscapes_ { false };
+};
+
+// Parsed templates of the snippets sent so far, dropped when the snippet is edited or deleted.
+// File snippets are sent as they are and have no template. Used on the storage thread.
+class templateCache
+{
+public:
+	using template_ptr_t = std::shared_ptr<const snippetTemplate>;
+
+	explicit templateCache(storage::shared_ptr_t source);
+	~templateCache();
+
+	templateCache(const templateCache&) = delete;
+	templateCache& operator=(const templateCache&) = delete;
+
+	// nullptr for file snippets and contents without placeholders or escapes
+	template_ptr_t get(const storage::snippet_t& snippet);
+
+private:
+	void onChange(const storage::change& what);
+
+	storage::shared_ptr_t storage_;
+	size_t listenerId_ { 0 };
+	// Contents without placeholders are kept as nullptr, so they are scanned once as well
+	std::unordered_map<uuids::uuid, template_ptr_t> templates_;
+};
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "data/sortedFolderView.h"
+
+#include <algorithm>
+
+namespace data
+{
+
+sortedFolderView::sortedFolderView(storage::shared_ptr_t source, const usageLog* usage)
+: storage_(std::move(source))
+, usage_(usage)
+{
+	listenerId_ = storage_->addChangeListener([this](const storage::change& what) { onChange(what); });
+}
+
+sortedFolderView::~sortedFolderView()
+{
+	storage_->removeChangeListener(listenerId_);
+}
+
+std::string sortedFolderView::collationKey(std::string_view name)
+{
+	std::string key;
+	key.reserve(name.size() * 2 + 8);
+	for (size_t i = 0; i < name.size();)
+	{
+		char ch = name[i];
+		if (ch < '0' || ch > '9')
+		{
+			key += (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+			i++;
+			continue;
+		}
+
+		// A digit run without its leading zeros, after its length: a longer number is a larger one.
+		// The run starts with '0', which no other key byte can be, so it sorts where digits do.
+		size_t end = i;
+		while (end < name.size() && name[end] >= '0' && name[end] <= '9')
+		{
+			end++;
+		}
+		auto digits = name.substr(i, end - i);
+		digits.remove_prefix(std::min(digits.find_first_not_of('0'), digits.size()));
+		key += '0';
+		key += static_cast<char>(std::min<size_t>(digits.size(), 255));
+		key.append(digits);
+		i = end;
+	}
+	key += '\0';
+	key.append(name);
+	return key;
+}
+
+const std::vector<storage::folder_shared_ptr_t>& sortedFolderView::folders(const storage::folder_shared_ptr_t& folder)
+{
+	if (order_ == order::stored)
+	{
+		return folder->subFolders_;
+	}
+	if (!isCurrent(folder))
+	{
+		sort(folder);
+	}
+	return folders_;
+}
+
+const storage::snippets_vec_t& sortedFolderView::snippets(const storage::folder_shared_ptr_t& folder)
+{
+	if (order_ == order::stored)
+	{
+		return folder->snippets_;
+	}
+	if (!isCurrent(folder))
+	{
+		sort(folder);
+	}
+	return snippets_;
+}
+
+bool sortedFolderView::isCurrent(const storage::folder_shared_ptr_t& folder) const
+{
+	// A placeholder filled since the sort does not bump the generation, but changes the sizes
+	return sortedFolder_.lock() == folder && sortedOrder_ == order_ && sortedGeneration_ == storage_->generation()
+		&& folders_.size() == folder->subFolders_.size() && snippets_.size() == folder->snippets_.size();
+}
+
+void sortedFolderView::sort(const storage::folder_shared_ptr_t& folder)
+{
+	std::vector<std::pair<const std::string*, storage::folder_shared_ptr_t>> folders;
+	folders.reserve(folder->subFolders_.size());
+	for (const auto& child : folder->subFolders_)
+	{
+		folders.emplace_back(&keyOf(child->uuid_, child->name_), child);
+	}
+	std::sort(folders.begin(), folders.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+	// Last use first when sorting by it, 0 for snippets never sent
+	struct snippetEntry
+	{
+		int64_t lastUsed;
+		const std::string* key;
+		storage::snippet_shared_ptr_t snippet;
+	};
+	std::vector<snippetEntry> snippets;
+	snippets.reserve(folder->snippets_.size());
+	for (const auto& snippet : folder->snippets_)
+	{
+		int64_t lastUsed = 0;
+		if (order_ == order::lastUsed && usage_)
+		{
+			if (auto used = usage_->find(snippet->uuid))
+			{
+				lastUsed = used->lastUsed;
+			}
+		}
+		snippets.push_back({ lastUsed, &keyOf(snippet->uuid, snippet->title), snippet });
+	}
+	std::sort(snippets.begin(), snippets.end(),
+		[](const auto& a, const auto& b) { return a.lastUsed != b.lastUsed ? a.lastUsed > b.lastUsed : *a.key < *b.key; });
+
+	folders_.clear();
+	for (auto& entry : folders)
+	{
+		folders_.push_back(std::move(entry.second));
+	}
+	snippets_.clear();
+	for (auto& entry : snippets)
+	{
+		snippets_.push_back(std::move(entry.snippet));
+	}
+
+	sortedFolder_ = folder;
+	sortedOrder_ = order_;
+	sortedGeneration_ = storage_->generation();
+}
+
+const std::string& sortedFolderView::keyOf(const uuids::uuid& uuid, std::string_view name)
+{
+	auto found = keys_.find(uuid);
+	if (found == keys_.end())
+	{
+		found = keys_.emplace(uuid, collationKey(name)).first;
+	}
+	return found->second;
+}
+
+void sortedFolderView::onChange(const storage::change& what)
+{
+	switch (what.what)
+	{
+	case storage::change::kind::folderRenamed:
+	case storage::change::kind::snippetEdited:
+	case storage::change::kind::snippetDeleted:
+		keys_.erase(what.uuid);
+		break;
+	case storage::change::kind::folderDeleted:
+		keys_.erase(what.uuid);
+		for (const auto& uuid : what.snippets)
+		{
+			keys_.erase(uuid);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+#include "data/usageLog.h"
+
+namespace data
+{
+
+// The children of a folder in the order the browser shows them. Every node gets its collation
+// key once, the first time a folder holding it is sorted; the storage change listener drops the
+// key of a renamed, edited or deleted node. The sorted lists of the last folder asked for are
+// kept until the folder, the order or the storage changes, so rendering only indexes into them.
+class sortedFolderView
+{
+public:
+	enum class order
+	{
+		// As stored: the order the nodes were created in
+		stored,
+		// By name, case-insensitive, with numbers compared by value
+		name,
+		// Most recently sent snippets first, the others and the folders by name
+		lastUsed
+	};
+
+	sortedFolderView(storage::shared_ptr_t source, const usageLog* usage = nullptr);
+	~sortedFolderView();
+
+	sortedFolderView(const sortedFolderView&) = delete;
+	sortedFolderView& operator=(const sortedFolderView&) = delete;
+
+	void setOrder(order value) { order_ = value; }
+	order getOrder() const { return order_; }
+
+	// Valid until the next call for another folder or the next modification of the storage
+	const std::vector<storage::folder_shared_ptr_t>& folders(const storage::folder_shared_ptr_t& folder);
+	const storage::snippets_vec_t& snippets(const storage::folder_shared_ptr_t& folder);
+
+	// Plain byte comparison of two keys orders their names: ASCII letters folded to lower case,
+	// digit runs by value; the name itself follows, so different names never compare equal
+	static std::string collationKey(std::string_view name);
+
+private:
+	bool isCurrent(const storage::folder_shared_ptr_t& folder) const;
+	void sort(const storage::folder_shared_ptr_t& folder);
+	const std::string& keyOf(const uuids::uuid& uuid, std::string_view name);
+	void onChange(const storage::change& what);
+
+	storage::shared_ptr_t storage_;
+	const usageLog* usage_;
+	size_t listenerId_ { 0 };
+	order order_ { order::stored };
+
+	std::unordered_map<uuids::uuid, std::string> keys_;
+
+	std::weak_ptr<storage::folder> sortedFolder_;
+	order sortedOrder_ { order::stored };
+	uint64_t sortedGeneration_ { 0 };
+	std::vector<storage::folder_shared_ptr_t> folders_;
+	storage::snippets_vec_t snippets_;
+};
+
+} // namespace data
\ No newline at end of file
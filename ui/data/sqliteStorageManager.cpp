@@ -0,0 +1,503 @@
+#include "data/sqliteStorageManager.h"
+
+#include <regex>
+#include <string_view>
+
+#include <sqlite3.h>
+
+namespace data
+{
+
+namespace
+{
+// Folder 1 is the root. Positions keep the order of a folder; new rows go after the last one.
+constexpr const char* schema = R"sql(
+PRAGMA journal_mode = WAL;
+PRAGMA foreign_keys = ON;
+
+CREATE TABLE IF NOT EXISTS folders (
+	id INTEGER PRIMARY KEY,
+	uuid BLOB NOT NULL UNIQUE,
+	parent INTEGER REFERENCES folders(id) ON DELETE CASCADE,
+	name TEXT NOT NULL,
+	position INTEGER NOT NULL
+);
+CREATE INDEX IF NOT EXISTS folders_parent ON folders(parent, position);
+
+CREATE TABLE IF NOT EXISTS snippets (
+	id INTEGER PRIMARY KEY,
+	uuid BLOB NOT NULL UNIQUE,
+	folder INTEGER NOT NULL REFERENCES folders(id) ON DELETE CASCADE,
+	title TEXT NOT NULL,
+	content TEXT NOT NULL,
+	from_file INTEGER NOT NULL DEFAULT 0,
+	position INTEGER NOT NULL
+);
+CREATE INDEX IF NOT EXISTS snippets_folder ON snippets(folder, position);
+
+CREATE VIRTUAL TABLE IF NOT EXISTS snippets_fts USING fts5(content, content = 'snippets', content_rowid = 'id', tokenize = 'trigram');
+CREATE TRIGGER IF NOT EXISTS snippets_fts_insert AFTER INSERT ON snippets BEGIN
+	INSERT INTO snippets_fts(rowid, content) VALUES (new.id, new.content);
+END;
+CREATE TRIGGER IF NOT EXISTS snippets_fts_delete AFTER DELETE ON snippets BEGIN
+	INSERT INTO snippets_fts(snippets_fts, rowid, content) VALUES ('delete', old.id, old.content);
+END;
+CREATE TRIGGER IF NOT EXISTS snippets_fts_update AFTER UPDATE OF content ON snippets WHEN old.content IS NOT new.content BEGIN
+	INSERT INTO snippets_fts(snippets_fts, rowid, content) VALUES ('delete', old.id, old.content);
+	INSERT INTO snippets_fts(rowid, content) VALUES (new.id, new.content);
+END;
+
+INSERT OR IGNORE INTO folders(id, uuid, parent, name, position) VALUES (1, zeroblob(16), NULL, '', 0);
+)sql";
+
+constexpr int64_t rootId = 1;
+
+bool exec(sqlite3* db, const char* sql)
+{
+	return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+class statement
+{
+public:
+	statement(sqlite3* db, const char* sql)
+	{
+		if (sqlite3_prepare_v2(db, sql, -1, &stmt_, nullptr) != SQLITE_OK)
+		{
+			sqlite3_finalize(stmt_);
+			stmt_ = nullptr;
+		}
+	}
+
+	~statement() { sqlite3_finalize(stmt_); }
+
+	statement(const statement&) = delete;
+	statement& operator=(const statement&) = delete;
+
+	explicit operator bool() const { return stmt_ != nullptr; }
+
+	// An empty view may have no data, which SQLite would bind as NULL
+	void bind(int index, std::string_view text) { sqlite3_bind_text(stmt_, index, text.data() ? text.data() : "", text.size(), SQLITE_TRANSIENT); }
+	void bind(int index, const uuids::uuid& uuid) { sqlite3_bind_blob(stmt_, index, uuid.as_bytes().data(), 16, SQLITE_TRANSIENT); }
+	void bind(int index, int64_t value) { sqlite3_bind_int64(stmt_, index, value); }
+
+	bool step() { return stmt_ && sqlite3_step(stmt_) == SQLITE_ROW; }
+
+	// Runs a statement without result rows; it can be bound and run again afterwards
+	bool run()
+	{
+		if (!stmt_)
+		{
+			return false;
+		}
+		bool done = sqlite3_step(stmt_) == SQLITE_DONE;
+		sqlite3_reset(stmt_);
+		return done;
+	}
+
+	std::string_view text(int column)
+	{
+		auto data = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, column));
+		return data ? std::string_view(data, sqlite3_column_bytes(stmt_, column)) : std::string_view {};
+	}
+
+	uuids::uuid uuid(int column)
+	{
+		auto data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt_, column));
+		return data && sqlite3_column_bytes(stmt_, column) == 16 ? uuids::uuid(data, data + 16) : uuids::uuid {};
+	}
+
+	int64_t integer(int column) { return sqlite3_column_int64(stmt_, column); }
+
+private:
+	sqlite3_stmt* stmt_ { nullptr };
+};
+
+// regexp(pattern, text), which SQLite calls for "text REGEXP pattern". The compiled pattern is
+// kept as auxiliary data, so it is compiled once per statement.
+void regexpFunction(sqlite3_context* context, int, sqlite3_value** argv)
+{
+	auto pattern = static_cast<std::regex*>(sqlite3_get_auxdata(context, 0));
+	if (!pattern)
+	{
+		auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+		try
+		{
+			pattern = new std::regex(text ? text : "", std::regex::ECMAScript | std::regex::icase);
+		}
+		catch (const std::regex_error&)
+		{
+			sqlite3_result_error(context, "invalid regular expression", -1);
+			return;
+		}
+		sqlite3_set_auxdata(context, 0, pattern, [](void* compiled) { delete static_cast<std::regex*>(compiled); });
+		// Freed right away when SQLite cannot keep it
+		pattern = static_cast<std::regex*>(sqlite3_get_auxdata(context, 0));
+		if (!pattern)
+		{
+			sqlite3_result_error_nomem(context);
+			return;
+		}
+	}
+
+	auto subject = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+	auto size = sqlite3_value_bytes(argv[1]);
+	sqlite3_result_int(context, subject && std::regex_search(subject, subject + size, *pattern));
+}
+} // namespace
+
+sqliteStorageManager::sqliteStorageManager()
+: storage_(std::make_shared<storage>())
+, usage_(std::make_unique<usageLog>(storage_))
+{ }
+
+sqliteStorageManager::~sqliteStorageManager()
+{
+	sqlite3_close_v2(db_);
+}
+
+bool sqliteStorageManager::open(const std::string& filename)
+{
+	if (db_)
+	{
+		return true;
+	}
+
+	// Access is serialized by dbMutex_
+	if (sqlite3_open_v2(filename.c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+	{
+		sqlite3_close_v2(db_);
+		db_ = nullptr;
+		return false;
+	}
+
+	// The daemon and a standalone browser may have the same database open
+	sqlite3_busy_timeout(db_, 2000);
+	sqlite3_create_function_v2(db_, "regexp", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, regexpFunction, nullptr, nullptr, nullptr);
+	if (!exec(db_, schema))
+	{
+		sqlite3_close_v2(db_);
+		db_ = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool sqliteStorageManager::load(const std::string& filename)
+{
+	usage_->open(filename);
+
+	{
+		std::lock_guard lock(dbMutex_);
+		if (!open(filename))
+		{
+			return false;
+		}
+
+		// Rows refer to their parent by uuid: the root takes the stored one, and only a new
+		// database gets the uuid the storage made up, so a load does not write
+		uuids::uuid stored;
+		{
+			statement root(db_, "SELECT uuid FROM folders WHERE id = 1");
+			if (root.step())
+			{
+				stored = root.uuid(0);
+			}
+		}
+		if (!stored.is_nil())
+		{
+			storage_->setRootUuid(stored);
+		}
+		else
+		{
+			statement root(db_, "UPDATE folders SET uuid = ?1 WHERE id = 1");
+			root.bind(1, storage_->root()->uuid_);
+			if (!root.run())
+			{
+				return false;
+			}
+		}
+	}
+
+	populate(*storage_, storage_->root(), rootId);
+	return true;
+}
+
+void sqliteStorageManager::populate(storage& target, const storage::folder_shared_ptr_t& placeholder, uint64_t handle) const
+{
+	std::lock_guard lock(dbMutex_);
+
+	statement snippets(db_, "SELECT uuid, title, content, from_file FROM snippets WHERE folder = ?1 ORDER BY position");
+	snippets.bind(1, static_cast<int64_t>(handle));
+	while (snippets.step())
+	{
+		target.insertSnippet(placeholder, target.makeSnippet(snippets.text(1), snippets.text(2), snippets.uuid(0), snippets.integer(3) != 0));
+	}
+
+	statement folders(db_, "SELECT id, uuid, name FROM folders WHERE parent = ?1 ORDER BY position");
+	folders.bind(1, static_cast<int64_t>(handle));
+	while (folders.step())
+	{
+		target.insertFolder(placeholder, target.makeLazyFolder(folders.text(2), folders.uuid(1), this, folders.integer(0)));
+	}
+}
+
+void sqliteStorageManager::record(const storage::change& what)
+{
+	rowWrite row { rowWrite::kind::saveSnippet, what.uuid, {}, {}, {} };
+	switch (what.what)
+	{
+	case storage::change::kind::snippetAdded:
+	case storage::change::kind::snippetEdited:
+	{
+		auto snippet = storage_->findSnippet(what.uuid);
+		auto owner = storage_->findSnippetFolder(what.uuid);
+		if (!snippet || !owner)
+		{
+			return;
+		}
+		row.parent = owner->uuid_;
+		row.name = snippet->title;
+		row.content = snippet->content();
+		row.from_file = snippet->from_file;
+		break;
+	}
+	case storage::change::kind::folderAdded:
+	case storage::change::kind::folderRenamed:
+	{
+		auto folder = storage_->findFolder(what.uuid);
+		auto parent = folder ? folder->parent_.lock() : nullptr;
+		if (!parent)
+		{
+			return;
+		}
+		row.what = rowWrite::kind::saveFolder;
+		row.parent = parent->uuid_;
+		row.name = folder->name_;
+		break;
+	}
+	case storage::change::kind::snippetDeleted:
+		row.what = rowWrite::kind::deleteSnippet;
+		break;
+	case storage::change::kind::folderDeleted:
+		// Its subfolders and snippets go with it through the foreign keys
+		row.what = rowWrite::kind::deleteFolder;
+		break;
+	}
+
+	std::lock_guard lock(pendingMutex_);
+	pending_.push_back(std::move(row));
+}
+
+bool sqliteStorageManager::flush(const std::string&)
+{
+	return applyPending();
+}
+
+bool sqliteStorageManager::applyPending()
+{
+	std::vector<rowWrite> rows;
+	{
+		std::lock_guard lock(pendingMutex_);
+		rows.swap(pending_);
+	}
+	if (rows.empty())
+	{
+		return true;
+	}
+
+	std::lock_guard lock(dbMutex_);
+	bool written = db_ && exec(db_, "BEGIN IMMEDIATE");
+	if (written)
+	{
+		// A row whose parent is gone by now is not written
+		statement saveSnippet(db_,
+			"INSERT INTO snippets(uuid, folder, title, content, from_file, position) "
+			"SELECT ?1, owner.id, ?3, ?4, ?5, (SELECT COALESCE(MAX(position) + 1, 0) FROM snippets WHERE folder = owner.id) "
+			"FROM folders AS owner WHERE owner.uuid = ?2 "
+			"ON CONFLICT(uuid) DO UPDATE SET title = excluded.title, content = excluded.content, from_file = excluded.from_file");
+		statement saveFolder(db_,
+			"INSERT INTO folders(uuid, parent, name, position) "
+			"SELECT ?1, owner.id, ?3, (SELECT COALESCE(MAX(position) + 1, 0) FROM folders WHERE parent = owner.id) "
+			"FROM folders AS owner WHERE owner.uuid = ?2 "
+			"ON CONFLICT(uuid) DO UPDATE SET name = excluded.name");
+		statement deleteSnippet(db_, "DELETE FROM snippets WHERE uuid = ?1");
+		statement deleteFolder(db_, "DELETE FROM folders WHERE uuid = ?1");
+
+		for (const auto& row : rows)
+		{
+			switch (row.what)
+			{
+			case rowWrite::kind::saveSnippet:
+				saveSnippet.bind(1, row.uuid);
+				saveSnippet.bind(2, row.parent);
+				saveSnippet.bind(3, row.name);
+				saveSnippet.bind(4, row.content);
+				saveSnippet.bind(5, static_cast<int64_t>(row.from_file));
+				written = saveSnippet.run();
+				break;
+			case rowWrite::kind::saveFolder:
+				saveFolder.bind(1, row.uuid);
+				saveFolder.bind(2, row.parent);
+				saveFolder.bind(3, row.name);
+				written = saveFolder.run();
+				break;
+			case rowWrite::kind::deleteSnippet:
+				deleteSnippet.bind(1, row.uuid);
+				written = deleteSnippet.run();
+				break;
+			case rowWrite::kind::deleteFolder:
+				deleteFolder.bind(1, row.uuid);
+				written = deleteFolder.run();
+				break;
+			}
+			if (!written)
+			{
+				break;
+			}
+		}
+		written = written && exec(db_, "COMMIT");
+	}
+
+	if (!written)
+	{
+		// Kept for the next flush, ahead of what was recorded meanwhile
+		if (db_)
+		{
+			exec(db_, "ROLLBACK");
+		}
+		std::lock_guard pendingLock(pendingMutex_);
+		pending_.insert(pending_.begin(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+	}
+	return written;
+}
+
+bool sqliteStorageManager::write(const std::string& filename, const storageImage& image)
+{
+	std::lock_guard lock(dbMutex_);
+	if (!open(filename) || !exec(db_, "BEGIN IMMEDIATE"))
+	{
+		return false;
+	}
+
+	bool written = exec(db_, "DELETE FROM snippets; DELETE FROM folders WHERE id <> 1;");
+
+	statement root(db_, "UPDATE folders SET uuid = ?1 WHERE id = 1 AND uuid <> ?1");
+	root.bind(1, image.folders[0].uuid);
+	written = written && root.run();
+
+	// Preorder: a parent always has its id before its children
+	std::vector<int64_t> ids(image.folders.size(), rootId);
+	std::vector<int64_t> nextPosition(image.folders.size(), 0);
+	statement insertFolder(db_, "INSERT INTO folders(uuid, parent, name, position) VALUES (?1, ?2, ?3, ?4)");
+	for (size_t i = 1; written && i < image.folders.size(); i++)
+	{
+		const auto& folder = image.folders[i];
+		insertFolder.bind(1, folder.uuid);
+		insertFolder.bind(2, ids[folder.parent]);
+		insertFolder.bind(3, folder.name);
+		insertFolder.bind(4, nextPosition[folder.parent]++);
+		written = insertFolder.run();
+		ids[i] = sqlite3_last_insert_rowid(db_);
+	}
+
+	statement insertSnippet(db_, "INSERT INTO snippets(uuid, folder, title, content, from_file, position) VALUES (?1, ?2, ?3, ?4, ?5, ?6)");
+	for (size_t i = 0; written && i < image.folders.size(); i++)
+	{
+		const auto& folder = image.folders[i];
+		for (uint32_t j = 0; written && j < folder.snippetCount; j++)
+		{
+			const auto& snippet = image.snippets[folder.firstSnippet + j];
+			insertSnippet.bind(1, snippet.uuid);
+			insertSnippet.bind(2, ids[i]);
+			insertSnippet.bind(3, snippet.title);
+			insertSnippet.bind(4, snippet.content());
+			insertSnippet.bind(5, static_cast<int64_t>(snippet.from_file));
+			insertSnippet.bind(6, static_cast<int64_t>(j));
+			written = insertSnippet.run();
+		}
+	}
+
+	written = written && exec(db_, "COMMIT");
+	if (!written)
+	{
+		exec(db_, "ROLLBACK");
+	}
+	return written;
+}
+
+std::vector<storage::snippet_shared_ptr_t> sqliteStorageManager::findSubstring(std::string_view needle, size_t limit)
+{
+	if (needle.empty())
+	{
+		return {};
+	}
+	applyPending();
+
+	// Trigrams need three characters; a shorter needle is looked for in every content
+	if (needle.size() < 3)
+	{
+		return findSnippets(queryUuids("SELECT uuid FROM snippets WHERE instr(lower(content), lower(?1)) > 0 LIMIT ?2", std::string(needle), limit));
+	}
+
+	// As one FTS5 string, which the trigram tokenizer matches as a substring
+	std::string phrase = "\"";
+	for (char ch : needle)
+	{
+		if (ch == '"')
+		{
+			phrase += '"';
+		}
+		phrase += ch;
+	}
+	phrase += '"';
+	return findSnippets(queryUuids(
+		"SELECT snippets.uuid FROM snippets_fts JOIN snippets ON snippets.id = snippets_fts.rowid WHERE snippets_fts MATCH ?1 LIMIT ?2", phrase, limit));
+}
+
+std::vector<storage::snippet_shared_ptr_t> sqliteStorageManager::findRegex(const std::string& pattern, size_t limit)
+{
+	applyPending();
+	return findSnippets(queryUuids("SELECT uuid FROM snippets WHERE content REGEXP ?1 LIMIT ?2", pattern, limit));
+}
+
+std::vector<uuids::uuid> sqliteStorageManager::queryUuids(const char* sql, const std::string& argument, size_t limit)
+{
+	std::vector<uuids::uuid> found;
+	std::lock_guard lock(dbMutex_);
+	if (!db_)
+	{
+		return found;
+	}
+
+	statement query(db_, sql);
+	query.bind(1, argument);
+	query.bind(2, static_cast<int64_t>(limit));
+	while (query.step())
+	{
+		found.push_back(query.uuid(0));
+	}
+	return found;
+}
+
+std::vector<storage::snippet_shared_ptr_t> sqliteStorageManager::findSnippets(const std::vector<uuids::uuid>& uuids)
+{
+	std::vector<storage::snippet_shared_ptr_t> snippets;
+	for (const auto& uuid : uuids)
+	{
+		auto snippet = storage_->findSnippet(uuid);
+		// Found in a folder that was not entered yet
+		if (!snippet && !storage_->fullyLoaded())
+		{
+			storage_->loadAll();
+			snippet = storage_->findSnippet(uuid);
+		}
+		if (snippet)
+		{
+			snippets.push_back(snippet);
+		}
+	}
+	return snippets;
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+#include "data/storageBackend.h"
+#include "data/usageLog.h"
+
+struct sqlite3;
+
+namespace data
+{
+
+// The storage as an SQLite database (data/storage.db): one row per folder and per snippet, the
+// order of a folder in a position column. Only the root level is read on load; every other
+// folder is a placeholder that reads its own rows when it is entered. A modification is recorded
+// as the row it changes and written in a single statement by the next flush. Content search goes
+// through an FTS5 table with the trigram tokenizer, kept in sync with the snippets by triggers.
+class sqliteStorageManager
+: public storageBackend
+, public contentSearch
+, private storage::subtreeSource
+{
+public:
+	sqliteStorageManager();
+	~sqliteStorageManager() override;
+
+	sqliteStorageManager(const sqliteStorageManager&) = delete;
+	sqliteStorageManager& operator=(const sqliteStorageManager&) = delete;
+
+	storage::shared_ptr_t getStorage() const override { return storage_; }
+
+	bool load(const std::string& filename) override;
+	void record(const storage::change& what) override;
+	bool flush(const std::string& filename) override;
+	bool write(const std::string& filename, const storageImage& image) override;
+
+	contentSearch& getContentSearch() override { return *this; }
+	usageLog& getUsage() override { return *usage_; }
+
+	// Writes recorded since the last flush are applied first, so the results are never behind
+	std::vector<storage::snippet_shared_ptr_t> findSubstring(std::string_view needle, size_t limit) override;
+	// Evaluated by SQLite through a regexp() function, over every content
+	std::vector<storage::snippet_shared_ptr_t> findRegex(const std::string& pattern, size_t limit) override;
+
+private:
+	// One recorded modification; the row as it was when the change happened
+	struct rowWrite
+	{
+		enum class kind
+		{
+			saveFolder,
+			saveSnippet,
+			deleteFolder,
+			deleteSnippet
+		};
+
+		kind what;
+		uuids::uuid uuid;
+		uuids::uuid parent;
+		std::string name;
+		std::string content;
+		bool from_file { false };
+	};
+
+	bool open(const std::string& filename);
+	bool applyPending();
+	std::vector<storage::snippet_shared_ptr_t> findSnippets(const std::vector<uuids::uuid>& uuids);
+	std::vector<uuids::uuid> queryUuids(const char* sql, const std::string& argument, size_t limit);
+
+	// Reads the rows of one folder, subfolders as placeholders; the handle is the folder id
+	void populate(storage& target, const storage::folder_shared_ptr_t& placeholder, uint64_t handle) const override;
+
+	storage::shared_ptr_t storage_;
+	std::unique_ptr<usageLog> usage_;
+
+	// Guards db_: placeholders are read on the storage thread, flushes run on the saver thread
+	mutable std::mutex dbMutex_;
+	sqlite3* db_ { nullptr };
+
+	std::mutex pendingMutex_;
+	std::vector<rowWrite> pending_;
+};
+
+} // namespace data
\ No newline at end of file
@@ -2,15 +2,27 @@
 #include "utils/generate_uuid.h"
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 
 namespace data
 {
 
+namespace
+{
+void setOwnedBody(storage::snippet_t& target, std::string_view content)
+{
+	target.owned = std::make_shared<const std::string>(content);
+	target.body = *target.owned;
+	target.source = nullptr;
+}
+} // namespace
+
 storage::storage()
 {
 	root_ = std::make_shared<folder>("/");
 	currentFolder_ = root_;
+	folderIndex_[root_->uuid_] = root_;
 }
 
 std::shared_ptr<storage::folder> storage::root() const
@@ -31,6 +43,15 @@ bool storage::curIsRoot() const
 void storage::setRoot()
 {
 	currentFolder_ = root_;
+	currentPath_ = "/";
+}
+
+void storage::setRootUuid(const uuids::uuid& uuid)
+{
+	std::lock_guard lock(mutex_);
+	folderIndex_.erase(root_->uuid_);
+	root_->uuid_ = uuid;
+	folderIndex_[root_->uuid_] = root_;
 }
 
 void storage::folderUp()
@@ -38,145 +59,362 @@ void storage::folderUp()
 	if (currentFolder_ != root_ && !currentFolder_->parent_.expired())
 	{
 		currentFolder_ = currentFolder_->parent_.lock();
+		updateCurrentPath();
 	}
 }
 
 void storage::folderDown(const uuids::uuid& folder_uuid)
 {
-	auto it = std::find_if(
-		currentFolder_->subFolders_.begin(), currentFolder_->subFolders_.end(), [&folder_uuid](const auto& pair) { return pair.second->uuid_ == folder_uuid; });
-
-	if (it != currentFolder_->subFolders_.end())
+	auto found = findFolder(folder_uuid);
+	if (found && found->parent_.lock() == currentFolder_)
 	{
-		currentFolder_ = it->second;
+		loadFolder(found);
+		currentFolder_ = found;
+		currentPath_.append(found->name_).append("/");
 	}
 }
 
-uuids::uuid storage::addFolder(const std::string& name)
+uuids::uuid storage::addFolder(std::string_view name)
 {
-	auto newFolder = std::make_shared<folder>(name);
-	newFolder->parent_ = currentFolder_;
-	currentFolder_->subFolders_[newFolder->uuid_] = newFolder;
+	std::lock_guard lock(mutex_);
+	// Time-ordered, so nodes keyed by uuid sort in the order they were created
+	auto newFolder = makeFolder(name, utils::generate_uuid(utils::uuid_kind::time_ordered));
+	insertFolder(currentFolder_, newFolder);
+	notifyChanged({ change::kind::folderAdded, newFolder->uuid_ });
 	return newFolder->uuid_;
 }
 
-uuids::uuid storage::addSnippet(const std::string title, const std::string& content, bool from_file)
+uuids::uuid storage::addSnippet(std::string_view title, std::string_view content, bool from_file)
 {
-	auto newSnippet = std::make_shared<snippet_t>(title, content, utils::generate_uuid(), from_file);
-	currentFolder_->snippets_.push_back(newSnippet);
+	std::lock_guard lock(mutex_);
+	auto newSnippet = std::make_shared<snippet_t>(strings_.intern(title), std::string_view {}, utils::generate_uuid(utils::uuid_kind::time_ordered), from_file);
+	setOwnedBody(*newSnippet, content);
+	insertSnippet(currentFolder_, newSnippet);
+	notifyChanged({ change::kind::snippetAdded, newSnippet->uuid });
 	return newSnippet->uuid;
 }
 
-uuids::uuid storage::addSnippet(const uuids::uuid& uuid, const std::string title, const std::string& content, bool from_file)
+uuids::uuid storage::addSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file)
 {
-	auto newSnippet = std::make_shared<snippet_t>(title, content, uuid, from_file);
-	currentFolder_->snippets_.push_back(newSnippet);
+	std::lock_guard lock(mutex_);
+	auto newSnippet = std::make_shared<snippet_t>(strings_.intern(title), std::string_view {}, uuid, from_file);
+	setOwnedBody(*newSnippet, content);
+	insertSnippet(currentFolder_, newSnippet);
+	notifyChanged({ change::kind::snippetAdded, newSnippet->uuid });
 	return newSnippet->uuid;
 }
 
 void storage::deleteFolder(const uuids::uuid& uuid)
 {
-	auto it = currentFolder_->subFolders_.find(uuid);
-	if (it != currentFolder_->subFolders_.end())
+	std::lock_guard lock(mutex_);
+	auto target = findFolder(uuid);
+	if (!target || target == root_)
+	{
+		return;
+	}
+
+	auto parent = target->parent_.lock();
+	if (!parent)
+	{
+		return;
+	}
+
+	// Do not leave the user inside a folder that no longer exists
+	for (auto f = currentFolder_; f; f = f->parent_.lock())
 	{
-		currentFolder_->subFolders_.erase(it);
+		if (f == target)
+		{
+			currentFolder_ = parent;
+			updateCurrentPath();
+			break;
+		}
 	}
+
+	change removed { change::kind::folderDeleted, uuid, {}, parent->uuid_ };
+	unindexFolder(target, &removed.snippets);
+	std::erase(parent->subFolders_, target);
+	generation_++;
+	notifyChanged(removed);
 }
 
 void storage::deleteSnippet(const uuids::uuid& uuid)
 {
-	auto& commands = currentFolder_->snippets_;
-	commands.erase(std::remove_if(commands.begin(), commands.end(), [&uuid](const auto& cmd) { return cmd->uuid == uuid; }), commands.end());
+	std::lock_guard lock(mutex_);
+	auto it = snippetIndex_.find(uuid);
+	if (it == snippetIndex_.end())
+	{
+		return;
+	}
+
+	change removed { change::kind::snippetDeleted, uuid };
+	if (auto owner = it->second.owner.lock())
+	{
+		removed.parent = owner->uuid_;
+		auto& commands = owner->snippets_;
+		auto cmd_it = std::find(commands.begin(), commands.end(), it->second.snippet);
+		if (cmd_it != commands.end())
+		{
+			commands.erase(cmd_it);
+		}
+	}
+
+	snippetIndex_.erase(it);
+	generation_++;
+	notifyChanged(removed);
 }
 
-void storage::renameFolder(const uuids::uuid& folder_uuid, const std::string& newName)
+void storage::renameFolder(const uuids::uuid& folder_uuid, std::string_view newName)
 {
-	auto it = currentFolder_->subFolders_.find(folder_uuid);
-	if (it != currentFolder_->subFolders_.end())
+	std::lock_guard lock(mutex_);
+	auto found = findFolder(folder_uuid);
+	if (found && found->name_ != newName)
 	{
-		it->second->name_ = newName;
+		found->name_ = strings_.intern(newName);
+		updateCurrentPath();
+		generation_++;
+		notifyChanged({ change::kind::folderRenamed, folder_uuid });
 	}
 }
 
-void storage::editSnippet(const uuids::uuid& uuid, const std::string title, const std::string& content, bool from_file)
+void storage::editSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file)
 {
-	auto& commands = currentFolder_->snippets_;
-	auto it = std::find_if(commands.begin(), commands.end(), [&uuid](const auto& cmd) { return cmd->uuid == uuid; });
+	std::lock_guard lock(mutex_);
+	auto found = findSnippet(uuid);
+	if (!found || (found->title == title && found->content() == content && found->from_file == from_file))
+	{
+		return;
+	}
 
-	if (it != commands.end())
+	// Unchanged content is kept as is, so renaming a snippet does not copy it
+	if (found->content() != content)
 	{
-		(*it)->content = content;
-		(*it)->title = title;
-		(*it)->from_file = from_file;
+		setOwnedBody(*found, content);
 	}
+	found->title = strings_.intern(title);
+	found->from_file = from_file;
+	generation_++;
+	notifyChanged({ change::kind::snippetEdited, uuid });
 }
 
 const storage::folder_shared_ptr_t storage::findFolder(const uuids::uuid& uuid) const
 {
-	return findFolderImpl(root_, uuid);
+	auto it = folderIndex_.find(uuid);
+	if (it == folderIndex_.end())
+	{
+		return nullptr;
+	}
+	return it->second.lock();
 }
 
 const storage::snippet_shared_ptr_t storage::findSnippet(const uuids::uuid& uuid) const
 {
-	// Search in current folder first
-	auto it = std::find_if(currentFolder_->snippets_.begin(), currentFolder_->snippets_.end(), [&uuid](const auto& cmd) { return cmd->uuid == uuid; });
+	auto it = snippetIndex_.find(uuid);
+	if (it == snippetIndex_.end())
+	{
+		return nullptr;
+	}
+	return it->second.snippet;
+}
 
-	if (it != currentFolder_->snippets_.end())
+const storage::folder_shared_ptr_t storage::findSnippetFolder(const uuids::uuid& uuid) const
+{
+	auto it = snippetIndex_.find(uuid);
+	if (it == snippetIndex_.end())
 	{
-		return (*it);
+		return nullptr;
 	}
+	return it->second.owner.lock();
+}
+
+storage::folder_shared_ptr_t storage::makeFolder(std::string_view name, const uuids::uuid& uuid)
+{
+	return std::make_shared<folder>(strings_.intern(name), uuid);
+}
 
-	// If not found, search recursively in all folders
-	folder_shared_ptr_t folder_with_command;
-	std::function<bool(const folder_shared_ptr_t&)> search = [&](const folder_shared_ptr_t& f)
+storage::snippet_shared_ptr_t storage::makeSnippet(std::string_view title, std::string_view content, const uuids::uuid& uuid, bool from_file)
+{
+	return std::make_shared<snippet_t>(strings_.intern(title), strings_.store(content), uuid, from_file);
+}
+
+storage::folder_shared_ptr_t storage::makeLazyFolder(std::string_view name, const uuids::uuid& uuid, const subtreeSource* source, uint64_t handle)
+{
+	auto newFolder = makeFolder(name, uuid);
+	newFolder->source_ = source;
+	newFolder->handle_ = handle;
+	return newFolder;
+}
+
+void storage::loadFolder(const folder_shared_ptr_t& target)
+{
+	if (target->isLoaded())
+	{
+		return;
+	}
+
+	std::lock_guard lock(mutex_);
+	auto source = target->source_;
+	target->source_ = nullptr;
+	pendingFolders_--;
+
+	auto generation = generation_;
+	source->populate(*this, target, target->handle_);
+	generation_ = generation;
+}
+
+void storage::loadAll()
+{
+	std::vector<folder_shared_ptr_t> pending { root_ };
+	while (pendingFolders_ > 0 && !pending.empty())
 	{
-		auto cmd_it = std::find_if(f->snippets_.begin(), f->snippets_.end(), [&uuid](const auto& cmd) { return cmd->uuid == uuid; });
+		auto current = std::move(pending.back());
+		pending.pop_back();
+		loadFolder(current);
 
-		if (cmd_it != f->snippets_.end())
+		for (const auto& subfolder : current->subFolders_)
 		{
-			folder_with_command = f;
-			return true;
+			pending.push_back(subfolder);
 		}
+	}
+}
+
+storage::snippet_shared_ptr_t storage::makeLazySnippet(std::string_view title, const contentSource* source, uint64_t handle, const uuids::uuid& uuid, bool from_file)
+{
+	return std::make_shared<snippet_t>(strings_.intern(title), std::string_view {}, uuid, from_file, source, handle);
+}
+
+void storage::insertFolder(const folder_shared_ptr_t& parent, const folder_shared_ptr_t& newFolder)
+{
+	std::lock_guard lock(mutex_);
+	while (folderIndex_.contains(newFolder->uuid_))
+	{
+		newFolder->uuid_ = utils::generate_uuid();
+	}
+
+	newFolder->parent_ = parent;
+	parent->subFolders_.push_back(newFolder);
+	folderIndex_[newFolder->uuid_] = newFolder;
+	if (!newFolder->isLoaded())
+	{
+		pendingFolders_++;
+	}
+	generation_++;
+}
+
+void storage::insertSnippet(const folder_shared_ptr_t& parent, const snippet_shared_ptr_t& newSnippet)
+{
+	std::lock_guard lock(mutex_);
+	while (snippetIndex_.contains(newSnippet->uuid))
+	{
+		newSnippet->uuid = utils::generate_uuid();
+	}
+
+	parent->snippets_.push_back(newSnippet);
+	snippetIndex_[newSnippet->uuid] = { newSnippet, parent };
+	generation_++;
+}
+
+size_t storage::addChangeListener(changeListener listener)
+{
+	changeListeners_.emplace_back(++lastListenerId_, std::move(listener));
+	return lastListenerId_;
+}
+
+void storage::removeChangeListener(size_t id)
+{
+	std::erase_if(changeListeners_, [id](const auto& entry) { return entry.first == id; });
+}
 
-		for (const auto& [_, subfolder] : f->subFolders_)
+void storage::notifyChanged(const change& what) const
+{
+	// A copy: a listener may remove itself
+	auto listeners = changeListeners_;
+	for (const auto& [_, listener] : listeners)
+	{
+		listener(what);
+	}
+}
+
+bool storage::checkIndex() const
+{
+	size_t folders = 0;
+	size_t snippets = 0;
+	bool consistent = true;
+
+	std::function<void(const folder_shared_ptr_t&)> check = [&](const folder_shared_ptr_t& current)
+	{
+		folders++;
+		auto it = folderIndex_.find(current->uuid_);
+		if (it == folderIndex_.end() || it->second.lock() != current)
+		{
+			consistent = false;
+		}
+
+		for (const auto& snippet : current->snippets_)
 		{
-			if (search(subfolder))
-				return true;
+			snippets++;
+			auto cmd_it = snippetIndex_.find(snippet->uuid);
+			if (cmd_it == snippetIndex_.end() || cmd_it->second.snippet != snippet || cmd_it->second.owner.lock() != current)
+			{
+				consistent = false;
+			}
 		}
 
-		return false;
+		for (const auto& subfolder : current->subFolders_)
+		{
+			if (subfolder->parent_.lock() != current)
+			{
+				consistent = false;
+			}
+			check(subfolder);
+		}
 	};
 
-	if (search(root_))
+	check(root_);
+	return consistent && folders == folderIndex_.size() && snippets == snippetIndex_.size();
+}
+
+void storage::unindexFolder(const folder_shared_ptr_t& current, std::vector<uuids::uuid>* removedSnippets)
+{
+	for (const auto& snippet : current->snippets_)
 	{
-		auto cmd_it =
-			std::find_if(folder_with_command->snippets_.begin(), folder_with_command->snippets_.end(), [&uuid](const auto& cmd) { return cmd->uuid == uuid; });
-		if (cmd_it != folder_with_command->snippets_.end())
+		snippetIndex_.erase(snippet->uuid);
+		if (removedSnippets)
 		{
-			return (*cmd_it);
+			removedSnippets->push_back(snippet->uuid);
 		}
 	}
 
-	return nullptr;
+	for (const auto& subfolder : current->subFolders_)
+	{
+		unindexFolder(subfolder, removedSnippets);
+	}
+
+	if (!current->isLoaded())
+	{
+		pendingFolders_--;
+	}
+	folderIndex_.erase(current->uuid_);
 }
 
-storage::folder_shared_ptr_t storage::findFolderImpl(const folder_shared_ptr_t& current, const uuids::uuid& uuid) const
+std::string storage::folderPath(const folder_shared_ptr_t& target) const
 {
-	if (current->uuid_ == uuid)
+	std::vector<std::string_view> names;
+	for (auto f = target; f && f != root_; f = f->parent_.lock())
 	{
-		return current;
+		names.push_back(f->name_);
 	}
 
-	for (const auto& [_, subfolder] : current->subFolders_)
+	std::string path = "/";
+	for (auto it = names.rbegin(); it != names.rend(); ++it)
 	{
-		auto found = findFolderImpl(subfolder, uuid);
-		if (found)
-		{
-			return found;
-		}
+		path.append(*it).append("/");
 	}
+	return path;
+}
 
-	return nullptr;
+void storage::updateCurrentPath()
+{
+	currentPath_ = folderPath(currentFolder_);
 }
 
 } // namespace data
\ No newline at end of file
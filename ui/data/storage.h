@@ -1,12 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
-#include <map>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include <uuid.h>
 
+#include "data/stringArena.h"
 #include "utils/generate_uuid.h"
 
 namespace data
@@ -17,13 +22,40 @@ class storage
 public:
 	using shared_ptr_t = std::shared_ptr<storage>;
 
+	// Produces the content of snippets whose body was left in the loaded file
+	class contentSource
+	{
+	public:
+		virtual ~contentSource() = default;
+		virtual std::string_view resolve(uint64_t handle) const = 0;
+	};
+
 	struct snippet
 	{
-		std::string title;
-		std::string content;
+		std::string_view title;
+		mutable std::string_view body;
 		uuids::uuid uuid;
 		bool from_file { false };
 
+		// Set while the body has not been read yet; cleared by the first content() call
+		mutable const contentSource* source { nullptr };
+		uint64_t handle { 0 };
+
+		// A body added or edited after load belongs to the snippet rather than the arena, so
+		// replacing or deleting it frees the memory in a resident process. An image taken
+		// for a save shares it until the save is done.
+		std::shared_ptr<const std::string> owned;
+
+		std::string_view content() const
+		{
+			if (source)
+			{
+				body = source->resolve(handle);
+				source = nullptr;
+			}
+			return body;
+		}
+
 		bool operator== (const uuids::uuid& other) const { return uuid == other; }
 	};
 
@@ -31,18 +63,35 @@ public:
 	using snippet_shared_ptr_t = std::shared_ptr<snippet_t>;
 	using snippets_vec_t = std::vector<snippet_shared_ptr_t>;
 
+	struct folder;
+
+	// Fills a placeholder folder with its snippets and (placeholder) subfolders
+	class subtreeSource
+	{
+	public:
+		virtual ~subtreeSource() = default;
+		virtual void populate(storage& target, const std::shared_ptr<folder>& placeholder, uint64_t handle) const = 0;
+	};
+
 	struct folder
 	{
-		std::string name_;
-		std::map<uuids::uuid, std::shared_ptr<folder>> subFolders_;
+		std::string_view name_;
+		// Display order, which is insertion order; lookups by uuid go through storage::findFolder
+		std::vector<std::shared_ptr<folder>> subFolders_;
 		snippets_vec_t snippets_;
 		std::weak_ptr<folder> parent_;
 		uuids::uuid uuid_;
 
-		folder(const std::string& name, uuids::uuid uuid = utils::generate_uuid())
+		// Set while the folder is a placeholder whose content has not been read yet
+		const subtreeSource* source_ { nullptr };
+		uint64_t handle_ { 0 };
+
+		folder(std::string_view name, uuids::uuid uuid = utils::generate_uuid())
 		: name_(name)
 		, uuid_(uuid)
 		{ }
+
+		bool isLoaded() const { return source_ == nullptr; }
 	};
 
 	using folder_shared_ptr_t = std::shared_ptr<folder>;
@@ -52,29 +101,123 @@ public:
 	folder_shared_ptr_t currentFolder() const;
 	bool curIsRoot() const;
 
+	// "/a/b/" for the current folder; kept up to date by navigation, renames and deletions
+	const std::string& currentPath() const { return currentPath_; }
+	std::string folderPath(const folder_shared_ptr_t& target) const;
+
 	void setRoot();
+	// For a backend that keeps the root uuid, before any other folder refers to the root
+	void setRootUuid(const uuids::uuid& uuid);
 
 	void folderUp();
 	void folderDown(const uuids::uuid& uuid);
 
-	uuids::uuid addFolder(const std::string& name);
-	uuids::uuid addSnippet(const std::string title, const std::string& content, bool from_file = false);
-	uuids::uuid addSnippet(const uuids::uuid& uuid, const std::string title, const std::string& content, bool from_file = false);
+	uuids::uuid addFolder(std::string_view name);
+	uuids::uuid addSnippet(std::string_view title, std::string_view content, bool from_file = false);
+	uuids::uuid addSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file = false);
 
 	void deleteFolder(const uuids::uuid& uuid);
 	void deleteSnippet(const uuids::uuid& uuid);
 
-	void renameFolder(const uuids::uuid& uuid, const std::string& newName);
-	void editSnippet(const uuids::uuid& uuid, const std::string title, const std::string& content, bool from_file = false);
+	void renameFolder(const uuids::uuid& uuid, std::string_view newName);
+	void editSnippet(const uuids::uuid& uuid, std::string_view title, std::string_view content, bool from_file = false);
 
 	const folder_shared_ptr_t findFolder(const uuids::uuid& uuid) const;
 	const snippet_shared_ptr_t findSnippet(const uuids::uuid& uuid) const;
+	const folder_shared_ptr_t findSnippetFolder(const uuids::uuid& uuid) const;
+
+	// Build detached nodes whose strings are copied into the storage arena.
+	// Folder names and snippet titles are interned, contents are copied as is.
+	folder_shared_ptr_t makeFolder(std::string_view name, const uuids::uuid& uuid);
+	snippet_shared_ptr_t makeSnippet(std::string_view title, std::string_view content, const uuids::uuid& uuid, bool from_file);
+	// Same, but the content stays in the source until it is first needed. The source must be
+	// kept alive with retainBuffer().
+	snippet_shared_ptr_t makeLazySnippet(std::string_view title, const contentSource* source, uint64_t handle, const uuids::uuid& uuid, bool from_file);
+	folder_shared_ptr_t makeLazyFolder(std::string_view name, const uuids::uuid& uuid, const subtreeSource* source, uint64_t handle);
+
+	// Placeholder folders are filled the first time they are entered. Whole-tree operations
+	// (dump, search, lookups of nodes that are not visible yet) call loadAll() first.
+	// Filling a placeholder is not a modification and does not bump the generation.
+	void loadFolder(const folder_shared_ptr_t& target);
+	void loadAll();
+
+	bool fullyLoaded() const { return pendingFolders_ == 0; }
+
+	// Held by every method that changes the tree or fills a placeholder. Reading can write too
+	// (a placeholder is filled, a lazy body is cached), so the owning thread also holds it while
+	// it reads, and another thread may then read the tree while holding it.
+	std::unique_lock<std::recursive_mutex> lock() const { return std::unique_lock(mutex_); }
+
+	// Used by loaders to attach already built nodes to the tree. Both keep the uuid index up to date
+	// and replace a uuid that is already taken by a freshly generated one. Loaders that build nodes
+	// over their own buffers hand them to retainBuffer() so the strings outlive the load.
+	void insertFolder(const folder_shared_ptr_t& parent, const folder_shared_ptr_t& newFolder);
+	void insertSnippet(const folder_shared_ptr_t& parent, const snippet_shared_ptr_t& newSnippet);
+	void retainBuffer(std::shared_ptr<const void> buffer) { strings_.retain(std::move(buffer)); }
+
+	// Walks the whole tree and compares it against the uuid index; loaders assert it once after a
+	// load, it is too slow to run after every operation
+	bool checkIndex() const;
+
+	const stringArena& strings() const { return strings_; }
+
+	// Bumped by every method that changes the tree or a node; navigation does not count
+	uint64_t generation() const { return generation_; }
+
+	// What a user modification changed. A deleted folder lists the snippets that went with it,
+	// as far as its subtree was loaded; a deleted node names the folder that held it.
+	struct change
+	{
+		enum class kind
+		{
+			snippetAdded,
+			snippetEdited,
+			snippetDeleted,
+			folderAdded,
+			folderRenamed,
+			folderDeleted
+		};
+
+		kind what;
+		uuids::uuid uuid;
+		std::vector<uuids::uuid> snippets {};
+		uuids::uuid parent {};
+	};
+
+	using changeListener = std::function<void(const change&)>;
+
+	// Listeners are called on the owning thread after every user modification (add, delete,
+	// rename, edit). Loaders and placeholder filling do not trigger them.
+	size_t addChangeListener(changeListener listener);
+	void removeChangeListener(size_t id);
 
 private:
-	folder_shared_ptr_t findFolderImpl(const folder_shared_ptr_t& current, const uuids::uuid& uuid) const;
+	struct snippetEntry
+	{
+		snippet_shared_ptr_t snippet;
+		std::weak_ptr<folder> owner;
+	};
+
+	void unindexFolder(const folder_shared_ptr_t& current, std::vector<uuids::uuid>* removedSnippets = nullptr);
+	void notifyChanged(const change& what) const;
+	void updateCurrentPath();
+
+	stringArena strings_;
 
 	folder_shared_ptr_t root_;
 	folder_shared_ptr_t currentFolder_;
+	std::string currentPath_ { "/" };
+
+	std::unordered_map<uuids::uuid, std::weak_ptr<folder>> folderIndex_;
+	std::unordered_map<uuids::uuid, snippetEntry> snippetIndex_;
+
+	uint64_t generation_ { 0 };
+	size_t pendingFolders_ { 0 };
+
+	mutable std::recursive_mutex mutex_;
+
+	std::vector<std::pair<size_t, changeListener>> changeListeners_;
+	size_t lastListenerId_ { 0 };
 };
 
 } // namespace data
\ No newline at end of file
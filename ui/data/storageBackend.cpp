@@ -0,0 +1,47 @@
+#include "data/storageBackend.h"
+
+#include <filesystem>
+#include <system_error>
+
+#include "data/sqliteStorageManager.h"
+#include "data/xmlStorageManager.h"
+
+namespace data
+{
+
+std::unique_ptr<storageBackend> makeStorageBackend(const std::string& location)
+{
+	if (std::filesystem::path(location).extension() == ".db")
+	{
+		return std::make_unique<sqliteStorageManager>();
+	}
+	return std::make_unique<xmlStorageManager>();
+}
+
+bool migrateStorage(const std::string& from, const std::string& to)
+{
+	// Opening a database that is not there would create an empty one
+	if (!std::filesystem::exists(from))
+	{
+		return false;
+	}
+
+	auto source = makeStorageBackend(from);
+	if (!source->load(from))
+	{
+		return false;
+	}
+
+	auto target = makeStorageBackend(to);
+	if (!target->write(to, storageImage::capture(*source->getStorage())))
+	{
+		return false;
+	}
+
+	// Uuids are kept, so the use counts still apply
+	std::error_code error;
+	std::filesystem::copy_file(usageLog::pathFor(from), usageLog::pathFor(to), std::filesystem::copy_options::skip_existing, error);
+	return true;
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "data/contentSearch.h"
+#include "data/storage.h"
+#include "data/storageImage.h"
+#include "data/usageLog.h"
+
+namespace data
+{
+
+// Where the storage is kept between runs. main.cpp picks one; the saver, the daemon and the
+// browser only go through this interface.
+//
+// Writing is split in two: record() runs on the storage thread right after a modification and
+// takes from the tree what the backend will need, flush() writes it later from the saver thread.
+class storageBackend
+{
+public:
+	virtual ~storageBackend() = default;
+
+	virtual storage::shared_ptr_t getStorage() const = 0;
+
+	// Fills the storage from the location, as lazily as the backend can
+	virtual bool load(const std::string& location) = 0;
+
+	// Storage thread, after every user modification
+	virtual void record(const storage::change& what) = 0;
+	// Writes what was recorded since the last flush. Any thread, one call at a time.
+	virtual bool flush(const std::string& location) = 0;
+
+	// Replaces everything at the location with the image; used to migrate between backends
+	virtual bool write(const std::string& location, const storageImage& image) = 0;
+
+	// After the last flush, before the process exits
+	virtual void close(const std::string& location) { }
+
+	virtual contentSearch& getContentSearch() = 0;
+	// Use counts of sent snippets, opened by load()
+	virtual usageLog& getUsage() = 0;
+};
+
+// SQLite for a ".db" location, xml for anything else
+std::unique_ptr<storageBackend> makeStorageBackend(const std::string& location);
+
+// Copies everything from one location to another, of the same or another backend. Uuids, names,
+// contents and the order of every folder are kept.
+bool migrateStorage(const std::string& from, const std::string& to);
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "data/storageImage.h"
+
+namespace data
+{
+
+namespace
+{
+void collect(storageImage& image, const storage::folder_shared_ptr_t& current, uint32_t index)
+{
+	image.folders[index].firstSnippet = static_cast<uint32_t>(image.snippets.size());
+	for (const auto& snippet : current->snippets_)
+	{
+		image.snippets.push_back({ snippet->title, snippet->body, snippet->uuid, snippet->from_file, snippet->source, snippet->handle, snippet->owned });
+	}
+	image.folders[index].snippetCount = static_cast<uint32_t>(image.snippets.size()) - image.folders[index].firstSnippet;
+
+	for (const auto& subFolder : current->subFolders_)
+	{
+		auto subIndex = static_cast<uint32_t>(image.folders.size());
+		image.folders.push_back({ subFolder->name_, subFolder->uuid_, index });
+		collect(image, subFolder, subIndex);
+		image.folders[subIndex].subtreeEnd = static_cast<uint32_t>(image.folders.size());
+	}
+}
+} // namespace
+
+storageImage storageImage::capture(storage& source)
+{
+	source.loadAll();
+
+	storageImage image;
+	image.generation = source.generation();
+	image.folders.push_back({ source.root()->name_, source.root()->uuid_, 0 });
+	collect(image, source.root(), 0);
+	image.folders[0].subtreeEnd = static_cast<uint32_t>(image.folders.size());
+	return image;
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+
+namespace data
+{
+
+// Point-in-time copy of the tree layout, taken on the thread that owns the storage or on
+// another one holding storage::lock(), and serialized on any. Only views are copied: the
+// strings live in the storage arena or in its retained buffers, which stay valid as long as
+// the storage itself.
+//
+// Folders are in preorder, folders[0] is the root and the subtree of folder i is
+// [i + 1, subtreeEnd). Snippets of one folder are contiguous.
+struct storageImage
+{
+	struct snippet
+	{
+		std::string_view title;
+		std::string_view body;
+		uuids::uuid uuid;
+		bool from_file { false };
+
+		// Bodies that were never read are resolved when the image is serialized
+		const storage::contentSource* source { nullptr };
+		uint64_t handle { 0 };
+
+		// Keeps an added or edited body alive when the snippet is edited again meanwhile
+		std::shared_ptr<const std::string> owned;
+
+		std::string_view content() const { return source ? source->resolve(handle) : body; }
+	};
+
+	struct folder
+	{
+		std::string_view name;
+		uuids::uuid uuid;
+		uint32_t parent { 0 };
+		uint32_t subtreeEnd { 0 };
+		uint32_t firstSnippet { 0 };
+		uint32_t snippetCount { 0 };
+	};
+
+	std::vector<folder> folders;
+	std::vector<snippet> snippets;
+	uint64_t generation { 0 };
+
+	// Fills every placeholder folder first, so the image always holds the whole tree
+	static storageImage capture(storage& source);
+};
+
+} // namespace data
\ No newline at end of file
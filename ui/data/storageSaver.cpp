@@ -0,0 +1,96 @@
+#include "data/storageSaver.h"
+
+#include <cstdio>
+
+namespace data
+{
+
+storageSaver::storageSaver(storageBackend& backend, std::string filename, std::chrono::milliseconds quietPeriod)
+: backend_(backend)
+, filename_(std::move(filename))
+, quietPeriod_(quietPeriod)
+, writer_(&storageSaver::run, this)
+{
+	listenerId_ = backend_.getStorage()->addChangeListener([this](const storage::change& what) { notify(what); });
+}
+
+storageSaver::~storageSaver()
+{
+	stop();
+}
+
+void storageSaver::notify(const storage::change& what)
+{
+	backend_.record(what);
+	{
+		std::lock_guard lock(mutex_);
+		pending_ = true;
+		lastChange_ = std::chrono::steady_clock::now();
+	}
+	wake_.notify_one();
+}
+
+bool storageSaver::stop()
+{
+	if (!writer_.joinable())
+	{
+		return !failed_;
+	}
+
+	backend_.getStorage()->removeChangeListener(listenerId_);
+	{
+		std::lock_guard lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_one();
+	writer_.join();
+
+	// The writer is gone, nothing else flushes now
+	for (int attempt = 1; failed_ && attempt <= finalRetries; attempt++)
+	{
+		std::this_thread::sleep_for(attempt * std::chrono::milliseconds(100));
+		failed_ = !backend_.flush(filename_);
+	}
+	if (failed_)
+	{
+		std::fprintf(stderr, "tmux-snippets: could not save %s, the last changes are lost\n", filename_.c_str());
+	}
+	return !failed_;
+}
+
+void storageSaver::run()
+{
+	std::unique_lock lock(mutex_);
+	while (true)
+	{
+		wake_.wait(lock, [this]() { return stopping_ || pending_; });
+
+		// Let the burst settle: every new change moves the deadline, stop writes right away
+		while (!stopping_)
+		{
+			auto deadline = lastChange_ + quietPeriod_;
+			if (!wake_.wait_until(lock, deadline, [this, deadline]() { return stopping_ || lastChange_ + quietPeriod_ != deadline; }))
+			{
+				break;
+			}
+		}
+
+		// Stopping always flushes: the backend may hold what no change announced, like a repaired uuid
+		if (pending_ || stopping_)
+		{
+			pending_ = false;
+
+			lock.unlock();
+			bool written = backend_.flush(filename_);
+			lock.lock();
+			failed_ = !written;
+		}
+
+		if (stopping_ && !pending_)
+		{
+			return;
+		}
+	}
+}
+
+} // namespace data
\ No newline at end of file
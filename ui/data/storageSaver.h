@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "data/storageBackend.h"
+
+namespace data
+{
+
+// Persists the storage from a background thread. Every modification is recorded by the backend
+// on the UI thread and wakes the writer; the writer waits until no new change came in for
+// quietPeriod and flushes once, so a burst of edits is one write.
+// Destroying the saver writes what is still pending and joins the thread.
+// A failed write stays with the backend and goes out with the next flush.
+class storageSaver
+{
+public:
+	storageSaver(storageBackend& backend, std::string filename, std::chrono::milliseconds quietPeriod = std::chrono::milliseconds(300));
+	~storageSaver();
+
+	storageSaver(const storageSaver&) = delete;
+	storageSaver& operator=(const storageSaver&) = delete;
+
+	// Called on the storage thread after a modification
+	void notify(const storage::change& what);
+
+	// Has the backend write what it still holds, if anything, and stops the writer. The last write is retried a few
+	// times; false, reported on stderr, when the changes could still not be saved
+	bool stop();
+
+private:
+	static constexpr int finalRetries = 3;
+
+	void run();
+
+	storageBackend& backend_;
+	std::string filename_;
+	std::chrono::milliseconds quietPeriod_;
+	size_t listenerId_ { 0 };
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool pending_ { false };
+	std::chrono::steady_clock::time_point lastChange_;
+	bool stopping_ { false };
+	// The last flush failed, what it had is waiting in the backend
+	bool failed_ { false };
+
+	std::thread writer_;
+};
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "data/stringArena.h"
+
+#include <cstring>
+
+namespace data
+{
+
+static constexpr size_t initialArenaBlock = 64 * 1024;
+
+stringArena::stringArena()
+: resource_(initialArenaBlock)
+{ }
+
+std::string_view stringArena::store(std::string_view value)
+{
+	stats_.stored++;
+	stats_.storedBytes += value.size();
+
+	if (value.empty())
+	{
+		return "";
+	}
+
+	auto* copy = static_cast<char*>(resource_.allocate(value.size() + 1, alignof(char)));
+	std::memcpy(copy, value.data(), value.size());
+	copy[value.size()] = '\0';
+	stats_.arenaBytes += value.size() + 1;
+
+	return { copy, value.size() };
+}
+
+std::string_view stringArena::intern(std::string_view value)
+{
+	if (auto it = interned_.find(value); it != interned_.end())
+	{
+		stats_.stored++;
+		stats_.storedBytes += value.size();
+		stats_.internHits++;
+		return *it;
+	}
+
+	auto copy = store(value);
+	interned_.insert(copy);
+	return copy;
+}
+
+void stringArena::retain(std::shared_ptr<const void> buffer)
+{
+	retained_.push_back(std::move(buffer));
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace data
+{
+
+// Owns the characters of every title, content and folder name of a loaded storage.
+// Memory is only returned when the arena itself is destroyed, so replaced strings stay
+// allocated until then. data::storage keeps only loaded contents and interned names and
+// titles here; contents added or edited later are owned by their snippets.
+class stringArena
+{
+public:
+	struct stats
+	{
+		size_t stored { 0 };        // strings handed to store()/intern()
+		size_t storedBytes { 0 };   // their total length
+		size_t internHits { 0 };    // intern() calls answered with an existing copy
+		size_t arenaBytes { 0 };    // bytes actually copied into the arena
+	};
+
+	stringArena();
+	stringArena(const stringArena&) = delete;
+	stringArena& operator= (const stringArena&) = delete;
+
+	// Copies the string into the arena. The result is NUL-terminated.
+	std::string_view store(std::string_view value);
+
+	// Same as store(), but equal strings share one copy
+	std::string_view intern(std::string_view value);
+
+	// Keeps an external buffer (e.g. a mapped file) alive for views that point into it
+	void retain(std::shared_ptr<const void> buffer);
+
+	const stats& getStats() const { return stats_; }
+
+private:
+	std::pmr::monotonic_buffer_resource resource_;
+	std::unordered_set<std::string_view> interned_;
+	std::vector<std::shared_ptr<const void>> retained_;
+	stats stats_;
+};
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,630 @@
+#include "data/trigramIndex.h"
+#include "utils/exePathManager.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <sstream>
+
+#include <sys/stat.h>
+
+namespace data
+{
+namespace
+{
+constexpr char indexMagic[8] = { 'T', 'M', 'X', 'T', 'R', 'G', 'M', '\0' };
+constexpr uint32_t indexVersion = 1;
+
+// Compaction only pays off once a good part of the documents are tombstones
+constexpr size_t compactThreshold = 1024;
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t documentCount;
+	uint64_t xmlSize;
+	int64_t xmlMtime;
+	uint64_t postingCount;
+};
+
+struct documentRecord
+{
+	uint8_t uuid[16];
+	int64_t fileMtime;
+};
+
+static_assert(sizeof(header) == 40 && sizeof(documentRecord) == 24, "index records must not contain padding");
+
+char fold(char c)
+{
+	return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+std::string folded(std::string_view text)
+{
+	std::string result(text.size(), '\0');
+	std::transform(text.begin(), text.end(), result.begin(), fold);
+	return result;
+}
+
+uint32_t trigramAt(std::string_view folded, size_t at)
+{
+	return uint32_t(uint8_t(folded[at])) << 16 | uint32_t(uint8_t(folded[at + 1])) << 8 | uint8_t(folded[at + 2]);
+}
+
+std::vector<uint32_t> trigramsOf(std::string_view folded)
+{
+	std::vector<uint32_t> result;
+	if (folded.size() < 3)
+	{
+		return result;
+	}
+	result.reserve(folded.size() - 2);
+	for (size_t i = 0; i + 2 < folded.size(); i++)
+	{
+		result.push_back(trigramAt(folded, i));
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+int64_t mtimeOf(const std::filesystem::path& path)
+{
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+	{
+		return 0;
+	}
+	return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// Indexed text: the content, or the text of the file for from_file snippets
+std::string indexedText(const storage::snippet_t& snippet, int64_t* fileMtime = nullptr)
+{
+	if (!snippet.from_file)
+	{
+		return std::string(snippet.content());
+	}
+
+	auto path = utils::exePathManager::getInstance().getFileSnippetPath(std::string(snippet.content()));
+	if (fileMtime)
+	{
+		*fileMtime = mtimeOf(path);
+	}
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	return buffer.str();
+}
+
+// Literal runs every match has to contain, folded. Only the top level of the pattern is looked at:
+// groups, classes and escapes end a run, and a quantified character is dropped from it.
+// A pattern with an alternation has no required literal at all.
+std::vector<std::string> requiredLiterals(const std::string& pattern)
+{
+	std::vector<std::string> literals;
+	if (pattern.find('|') != std::string::npos)
+	{
+		return literals;
+	}
+
+	std::string run;
+	auto endRun = [&]()
+	{
+		if (run.size() >= 3)
+		{
+			literals.push_back(run);
+		}
+		run.clear();
+	};
+
+	int depth = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		char c = pattern[i];
+		switch (c)
+		{
+		case '\\':
+			// \d, \w, \b... are classes or assertions, other escapes are the character itself
+			if (i + 1 < pattern.size() && !std::isalnum(static_cast<unsigned char>(pattern[i + 1])) && depth == 0)
+			{
+				run += fold(pattern[++i]);
+			}
+			else
+			{
+				endRun();
+				i++;
+				// Skip the operands of \xhh, \uhhhh, \cX and back references
+				if (i < pattern.size())
+				{
+					switch (pattern[i])
+					{
+					case 'x': i += 2; break;
+					case 'u': i += 4; break;
+					case 'c': i += 1; break;
+					default:
+						while (i + 1 < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i + 1])))
+						{
+							i++;
+						}
+						break;
+					}
+				}
+			}
+			break;
+		case '*':
+		case '?':
+		case '{':
+			if (!run.empty())
+			{
+				run.pop_back();
+			}
+			endRun();
+			if (c == '{')
+			{
+				i = std::min(pattern.find('}', i), pattern.size());
+			}
+			break;
+		case '[':
+		{
+			endRun();
+			// Where the class ends is only certain when its members are plain characters: an
+			// escape, a leading "]" or a "[:alpha:]" inside could each move the end, and a wrong
+			// end would turn part of the class into a required literal. Such a pattern requires nothing.
+			size_t end = i + 1;
+			if (end < pattern.size() && pattern[end] == '^')
+			{
+				end++;
+			}
+			if (end < pattern.size() && pattern[end] == ']')
+			{
+				return {};
+			}
+			for (; end < pattern.size() && pattern[end] != ']'; end++)
+			{
+				if (pattern[end] == '\\' || pattern[end] == '[')
+				{
+					return {};
+				}
+			}
+			if (end == pattern.size())
+			{
+				return {};
+			}
+			i = end;
+			break;
+		}
+		case '(':
+			endRun();
+			depth++;
+			break;
+		case ')':
+			endRun();
+			depth = std::max(depth - 1, 0);
+			break;
+		case '.':
+		case '^':
+		case '$':
+		case '+':
+			// "x+" still needs the x, the run just cannot continue past it
+			endRun();
+			break;
+		default:
+			if (depth == 0)
+			{
+				run += fold(c);
+			}
+			break;
+		}
+	}
+	endRun();
+	return literals;
+}
+} // namespace
+
+trigramIndex::trigramIndex(storage::shared_ptr_t source)
+: storage_(std::move(source))
+{
+	listenerId_ = storage_->addChangeListener([this](const storage::change& what) { onChange(what); });
+}
+
+trigramIndex::~trigramIndex()
+{
+	storage_->removeChangeListener(listenerId_);
+}
+
+std::filesystem::path trigramIndex::pathFor(const std::filesystem::path& xmlPath)
+{
+	auto path = xmlPath;
+	path += ".trigrams";
+	return path;
+}
+
+bool trigramIndex::load(const std::filesystem::path& xmlPath, const snapshotCache::fileStamp& xmlStamp)
+{
+	std::ifstream in(pathFor(xmlPath), std::ios::binary);
+	header head {};
+	if (!in.read(reinterpret_cast<char*>(&head), sizeof(head)) || std::memcmp(head.magic, indexMagic, sizeof(indexMagic)) != 0
+		|| head.version != indexVersion || head.xmlSize != xmlStamp.size || head.xmlMtime != xmlStamp.mtime)
+	{
+		return false;
+	}
+
+	std::vector<document> documents(head.documentCount);
+	std::unordered_map<uuids::uuid, uint32_t> documentIndex;
+	documentIndex.reserve(head.documentCount);
+	for (uint32_t i = 0; i < head.documentCount; i++)
+	{
+		documentRecord record;
+		if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+		{
+			return false;
+		}
+		documents[i].uuid = uuids::uuid(std::begin(record.uuid), std::end(record.uuid));
+		documents[i].fileMtime = record.fileMtime;
+		documentIndex.emplace(documents[i].uuid, i);
+	}
+
+	std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+	postings.reserve(head.postingCount);
+	for (uint64_t i = 0; i < head.postingCount; i++)
+	{
+		uint32_t entry[2];
+		if (!in.read(reinterpret_cast<char*>(entry), sizeof(entry)) || entry[1] > head.documentCount)
+		{
+			return false;
+		}
+		auto& list = postings[entry[0]];
+		list.resize(entry[1]);
+		if (!in.read(reinterpret_cast<char*>(list.data()), list.size() * sizeof(uint32_t)))
+		{
+			return false;
+		}
+		if (std::any_of(list.begin(), list.end(), [&](uint32_t id) { return id >= head.documentCount; }) || !std::is_sorted(list.begin(), list.end()))
+		{
+			return false;
+		}
+	}
+
+	documents_ = std::move(documents);
+	documentIndex_ = std::move(documentIndex);
+	postings_ = std::move(postings);
+	deadDocuments_ = 0;
+	built_ = true;
+	dirty_ = false;
+
+	filesChecked_ = false;
+	savedStamp_ = xmlStamp;
+	return true;
+}
+
+bool trigramIndex::save(const std::filesystem::path& xmlPath, const snapshotCache::fileStamp& xmlStamp)
+{
+	// The xml is rewritten by every save, the index file then has to follow its stamp even when
+	// no content changed
+	if (!built_ || (!dirty_ && xmlStamp.size == savedStamp_.size && xmlStamp.mtime == savedStamp_.mtime))
+	{
+		return true;
+	}
+	if (deadDocuments_ > 0)
+	{
+		compact();
+	}
+
+	header head {};
+	std::memcpy(head.magic, indexMagic, sizeof(indexMagic));
+	head.version = indexVersion;
+	head.documentCount = static_cast<uint32_t>(documents_.size());
+	head.xmlSize = xmlStamp.size;
+	head.xmlMtime = xmlStamp.mtime;
+	head.postingCount = postings_.size();
+
+	// Written aside and renamed, so a killed process leaves either the old index or the new one
+	auto path = pathFor(xmlPath);
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		for (const auto& doc : documents_)
+		{
+			documentRecord record {};
+			std::memcpy(record.uuid, doc.uuid.as_bytes().data(), sizeof(record.uuid));
+			record.fileMtime = doc.fileMtime;
+			out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		for (const auto& [trigram, list] : postings_)
+		{
+			uint32_t entry[2] = { trigram, static_cast<uint32_t>(list.size()) };
+			out.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+			out.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(uint32_t));
+		}
+		if (!out.good())
+		{
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
+	{
+		return false;
+	}
+	dirty_ = false;
+	savedStamp_ = xmlStamp;
+	return true;
+}
+
+void trigramIndex::ensureBuilt()
+{
+	if (built_)
+	{
+		if (!filesChecked_)
+		{
+			refreshFileSnippets();
+		}
+		return;
+	}
+
+	storage_->loadAll();
+	std::vector<storage::folder_shared_ptr_t> pending { storage_->root() };
+	while (!pending.empty())
+	{
+		auto current = std::move(pending.back());
+		pending.pop_back();
+		for (const auto& snippet : current->snippets_)
+		{
+			add(*snippet);
+		}
+		for (const auto& subFolder : current->subFolders_)
+		{
+			pending.push_back(subFolder);
+		}
+	}
+	built_ = true;
+	filesChecked_ = true;
+	dirty_ = true;
+}
+
+void trigramIndex::refreshFileSnippets()
+{
+	// Files of from_file snippets are edited outside of the storage, those changed since the index
+	// was written are indexed again
+	storage_->loadAll();
+	std::vector<uuids::uuid> changedFiles;
+	for (const auto& [uuid, id] : documentIndex_)
+	{
+		const auto& doc = documents_[id];
+		auto snippet = storage_->findSnippet(uuid);
+		if (!snippet || snippet->from_file != (doc.fileMtime != 0)
+			|| (snippet->from_file && mtimeOf(utils::exePathManager::getInstance().getFileSnippetPath(std::string(snippet->content()))) != doc.fileMtime))
+		{
+			changedFiles.push_back(uuid);
+		}
+	}
+	for (const auto& uuid : changedFiles)
+	{
+		remove(uuid);
+		if (auto snippet = storage_->findSnippet(uuid))
+		{
+			add(*snippet);
+		}
+	}
+	filesChecked_ = true;
+}
+
+void trigramIndex::onChange(const storage::change& what)
+{
+	// Nothing to keep up to date until the first build, which reads the tree as it is then
+	if (!built_)
+	{
+		return;
+	}
+
+	switch (what.what)
+	{
+	case storage::change::kind::snippetAdded:
+	case storage::change::kind::snippetEdited:
+		remove(what.uuid);
+		if (auto snippet = storage_->findSnippet(what.uuid))
+		{
+			add(*snippet);
+		}
+		break;
+	case storage::change::kind::snippetDeleted:
+		remove(what.uuid);
+		break;
+	case storage::change::kind::folderDeleted:
+		for (const auto& uuid : what.snippets)
+		{
+			remove(uuid);
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (deadDocuments_ > compactThreshold && deadDocuments_ > documentIndex_.size())
+	{
+		compact();
+	}
+}
+
+void trigramIndex::add(const storage::snippet_t& snippet)
+{
+	document doc { snippet.uuid };
+	auto text = folded(indexedText(snippet, &doc.fileMtime));
+	auto id = static_cast<uint32_t>(documents_.size());
+	documents_.push_back(doc);
+	documentIndex_[snippet.uuid] = id;
+	for (auto trigram : trigramsOf(text))
+	{
+		postings_[trigram].push_back(id);
+	}
+	dirty_ = true;
+}
+
+void trigramIndex::remove(const uuids::uuid& uuid)
+{
+	auto it = documentIndex_.find(uuid);
+	if (it == documentIndex_.end())
+	{
+		return;
+	}
+	// Posting lists keep the id until the next compaction
+	documents_[it->second].alive = false;
+	documentIndex_.erase(it);
+	deadDocuments_++;
+	dirty_ = true;
+}
+
+void trigramIndex::compact()
+{
+	std::vector<uint32_t> renumbered(documents_.size(), UINT32_MAX);
+	std::vector<document> documents;
+	documents.reserve(documentIndex_.size());
+	for (uint32_t i = 0; i < documents_.size(); i++)
+	{
+		if (documents_[i].alive)
+		{
+			renumbered[i] = static_cast<uint32_t>(documents.size());
+			documentIndex_[documents_[i].uuid] = renumbered[i];
+			documents.push_back(documents_[i]);
+		}
+	}
+
+	for (auto it = postings_.begin(); it != postings_.end();)
+	{
+		auto& list = it->second;
+		size_t kept = 0;
+		for (auto id : list)
+		{
+			if (renumbered[id] != UINT32_MAX)
+			{
+				list[kept++] = renumbered[id];
+			}
+		}
+		list.resize(kept);
+		it = list.empty() ? postings_.erase(it) : std::next(it);
+	}
+
+	documents_ = std::move(documents);
+	deadDocuments_ = 0;
+}
+
+std::vector<uint32_t> trigramIndex::candidates(const std::vector<std::string>& literals) const
+{
+	std::vector<const std::vector<uint32_t>*> lists;
+	for (const auto& literal : literals)
+	{
+		for (auto trigram : trigramsOf(literal))
+		{
+			auto it = postings_.find(trigram);
+			if (it == postings_.end())
+			{
+				return {};
+			}
+			lists.push_back(&it->second);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	if (lists.empty())
+	{
+		for (uint32_t i = 0; i < documents_.size(); i++)
+		{
+			if (documents_[i].alive)
+			{
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+
+	// Shortest list first, so the intermediate result only shrinks
+	std::sort(lists.begin(), lists.end(), [](const auto* lhs, const auto* rhs) { return lhs->size() < rhs->size(); });
+	lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+	std::copy_if(lists.front()->begin(), lists.front()->end(), std::back_inserter(result), [this](uint32_t id) { return documents_[id].alive; });
+
+	std::vector<uint32_t> next;
+	for (size_t i = 1; i < lists.size() && !result.empty(); i++)
+	{
+		next.clear();
+		std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(next));
+		result.swap(next);
+	}
+	return result;
+}
+
+template<typename Matches>
+std::vector<storage::snippet_shared_ptr_t> trigramIndex::verify(const std::vector<uint32_t>& candidates, size_t limit, Matches&& matches)
+{
+	std::vector<storage::snippet_shared_ptr_t> result;
+	if (candidates.empty())
+	{
+		return result;
+	}
+
+	// Candidates are only uuids; lookups have to see the whole tree
+	storage_->loadAll();
+	std::vector<uuids::uuid> stale;
+	for (auto id : candidates)
+	{
+		if (result.size() >= limit)
+		{
+			break;
+		}
+		auto snippet = storage_->findSnippet(documents_[id].uuid);
+		if (!snippet)
+		{
+			stale.push_back(documents_[id].uuid);
+			continue;
+		}
+		if (matches(folded(indexedText(*snippet))))
+		{
+			result.push_back(snippet);
+		}
+	}
+
+	for (const auto& uuid : stale)
+	{
+		remove(uuid);
+	}
+	return result;
+}
+
+std::vector<storage::snippet_shared_ptr_t> trigramIndex::findSubstring(std::string_view needle, size_t limit)
+{
+	ensureBuilt();
+	auto foldedNeedle = folded(needle);
+	return verify(candidates({ foldedNeedle }), limit,
+		[&foldedNeedle](const std::string& text) { return text.find(foldedNeedle) != std::string::npos; });
+}
+
+std::vector<storage::snippet_shared_ptr_t> trigramIndex::findRegex(const std::string& pattern, size_t limit)
+{
+	std::regex expression;
+	try
+	{
+		expression = std::regex(pattern, std::regex::ECMAScript | std::regex::icase);
+	}
+	catch (const std::regex_error&)
+	{
+		return {};
+	}
+
+	ensureBuilt();
+	// The text is folded already, icase only matters for classes written in upper case
+	return verify(candidates(requiredLiterals(pattern)), limit,
+		[&expression](const std::string& text) { return std::regex_search(text, expression); });
+}
+
+} // namespace data
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/contentSearch.h"
+#include "data/snapshotCache.h"
+#include "data/storage.h"
+
+namespace data
+{
+
+// Inverted index from the trigrams of snippet contents (case-folded) to the snippets holding
+// them; from_file snippets are indexed by the text of their file. Queries intersect the
+// posting lists of the query trigrams and only check the content of the remaining candidates.
+//
+// Kept up to date through the storage change listener. Persisted next to the xml
+// (storage.xml.trigrams) with the xml stamp, like snapshotCache, and rebuilt on first use
+// when that file is missing or stale.
+class trigramIndex : public contentSearch
+{
+public:
+	explicit trigramIndex(storage::shared_ptr_t source);
+	~trigramIndex() override;
+
+	trigramIndex(const trigramIndex&) = delete;
+	trigramIndex& operator=(const trigramIndex&) = delete;
+
+	static std::filesystem::path pathFor(const std::filesystem::path& xmlPath);
+
+	// Takes the persisted index when it was written for the xml file with this stamp
+	bool load(const std::filesystem::path& xmlPath, const snapshotCache::fileStamp& xmlStamp);
+	// Only writes when the index or the xml file changed since the index was built or loaded
+	bool save(const std::filesystem::path& xmlPath, const snapshotCache::fileStamp& xmlStamp);
+
+	std::vector<storage::snippet_shared_ptr_t> findSubstring(std::string_view needle, size_t limit) override;
+	// Literal runs of the pattern narrow the candidates when the pattern has no alternation
+	std::vector<storage::snippet_shared_ptr_t> findRegex(const std::string& pattern, size_t limit) override;
+
+	size_t documentCount() const { return documentIndex_.size(); }
+
+private:
+	struct document
+	{
+		uuids::uuid uuid;
+		// Modification time of the file of a from_file snippet, 0 otherwise
+		int64_t fileMtime { 0 };
+		bool alive { true };
+	};
+
+	void ensureBuilt();
+	void refreshFileSnippets();
+	void onChange(const storage::change& what);
+
+	void add(const storage::snippet_t& snippet);
+	void remove(const uuids::uuid& uuid);
+	void compact();
+
+	// Alive documents holding every trigram of every literal; all alive ones without literals
+	std::vector<uint32_t> candidates(const std::vector<std::string>& literals) const;
+
+	template<typename Matches>
+	std::vector<storage::snippet_shared_ptr_t> verify(const std::vector<uint32_t>& candidates, size_t limit, Matches&& matches);
+
+	storage::shared_ptr_t storage_;
+	size_t listenerId_ { 0 };
+
+	bool built_ { false };
+	bool dirty_ { false };
+	bool filesChecked_ { false };
+	snapshotCache::fileStamp savedStamp_;
+
+	std::vector<document> documents_;
+	std::unordered_map<uuids::uuid, uint32_t> documentIndex_;
+	// Document ids only grow, so every posting list stays sorted
+	std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+	size_t deadDocuments_ { 0 };
+};
+
+} // namespace data
\ No newline at end of file
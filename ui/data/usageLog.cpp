@@ -0,0 +1,256 @@
+#include "data/usageLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace data
+{
+namespace
+{
+constexpr char usageMagic[8] = { 'T', 'M', 'X', 'U', 'S', 'A', 'G', 'E' };
+constexpr uint32_t usageVersion = 1;
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+// The whole state of one snippet after its last use; replaying keeps the last record of each uuid.
+// A record with a zero count removes the snippet.
+struct usageRecord
+{
+	uint8_t uuid[16];
+	int64_t lastUsed;
+	double rank;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(header) == 16 && sizeof(usageRecord) == 40, "usage records must not contain padding");
+
+usageRecord toRecord(const uuids::uuid& uuid, const usageLog::entry& state)
+{
+	usageRecord record {};
+	std::memcpy(record.uuid, uuid.as_bytes().data(), sizeof(record.uuid));
+	record.lastUsed = state.lastUsed;
+	record.rank = state.rank;
+	record.count = state.count;
+	return record;
+}
+} // namespace
+
+usageLog::usageLog(storage::shared_ptr_t source, size_t capacity)
+: storage_(std::move(source))
+, capacity_(capacity)
+{
+	listenerId_ = storage_->addChangeListener([this](const storage::change& what) { onChange(what); });
+}
+
+usageLog::~usageLog()
+{
+	storage_->removeChangeListener(listenerId_);
+	if (fd_ >= 0)
+	{
+		::close(fd_);
+	}
+}
+
+std::filesystem::path usageLog::pathFor(const std::filesystem::path& xmlPath)
+{
+	auto path = xmlPath;
+	path += ".usage";
+	return path;
+}
+
+int64_t usageLog::currentTime()
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool usageLog::open(const std::filesystem::path& xmlPath)
+{
+	auto path = pathFor(xmlPath);
+	bool valid = false;
+	bool torn = false;
+	{
+		std::ifstream in(path, std::ios::binary);
+		header head {};
+		valid = in.read(reinterpret_cast<char*>(&head), sizeof(head)) && std::memcmp(head.magic, usageMagic, sizeof(usageMagic)) == 0
+			&& head.version == usageVersion;
+
+		usageRecord record;
+		while (valid && in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+		{
+			auto uuid = uuids::uuid(std::begin(record.uuid), std::end(record.uuid));
+			if (record.count == 0)
+			{
+				entries_.erase(uuid);
+			}
+			else
+			{
+				entries_[uuid] = { record.count, record.lastUsed, record.rank };
+			}
+			records_++;
+		}
+		// Part of a record is left by a process killed in the middle of an append
+		torn = valid && in.gcount() > 0;
+	}
+
+	// A missing or foreign file starts empty, a long one is rewritten with one record per snippet.
+	// A torn tail is cut off, or every later append would be misaligned.
+	if (!valid || records_ > 4 * entries_.size() + 256
+		|| (torn && ::truncate(path.c_str(), off_t(sizeof(header) + records_ * sizeof(usageRecord))) != 0))
+	{
+		compact(path);
+	}
+
+	fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+	refill();
+	return fd_ >= 0;
+}
+
+void usageLog::recordUse(const uuids::uuid& uuid, int64_t now)
+{
+	auto& state = entries_[uuid];
+	// The score decayed to now, plus this use
+	double score = state.count == 0 ? 0.0 : std::exp2(state.rank - double(now) / halfLife);
+	state.rank = std::log2(score + 1.0) + double(now) / halfLife;
+	state.count++;
+	state.lastUsed = now;
+
+	append(uuid, state);
+	offer(uuid);
+}
+
+void usageLog::forget(const uuids::uuid& uuid)
+{
+	if (entries_.erase(uuid) == 0)
+	{
+		return;
+	}
+	append(uuid, {});
+
+	if (std::find(top_.begin(), top_.end(), uuid) != top_.end())
+	{
+		refill();
+	}
+}
+
+std::vector<uuids::uuid> usageLog::recent() const
+{
+	auto result = top_;
+	std::sort(result.begin(), result.end(), [this](const auto& lhs, const auto& rhs) { return entries_.at(lhs).rank > entries_.at(rhs).rank; });
+	return result;
+}
+
+const usageLog::entry* usageLog::find(const uuids::uuid& uuid) const
+{
+	auto it = entries_.find(uuid);
+	return it == entries_.end() ? nullptr : &it->second;
+}
+
+void usageLog::onChange(const storage::change& what)
+{
+	switch (what.what)
+	{
+	case storage::change::kind::snippetDeleted:
+		forget(what.uuid);
+		break;
+	case storage::change::kind::folderDeleted:
+		for (const auto& uuid : what.snippets)
+		{
+			forget(uuid);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void usageLog::append(const uuids::uuid& uuid, const entry& state)
+{
+	if (fd_ < 0)
+	{
+		return;
+	}
+	// One write of a whole record: appends of several processes do not interleave
+	auto record = toRecord(uuid, state);
+	if (::write(fd_, &record, sizeof(record)) == sizeof(record))
+	{
+		records_++;
+	}
+}
+
+void usageLog::compact(const std::filesystem::path& path)
+{
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		header head {};
+		std::memcpy(head.magic, usageMagic, sizeof(usageMagic));
+		head.version = usageVersion;
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		for (const auto& [uuid, state] : entries_)
+		{
+			auto record = toRecord(uuid, state);
+			out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		if (!out.good())
+		{
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	records_ = entries_.size();
+}
+
+void usageLog::offer(const uuids::uuid& uuid)
+{
+	// std heaps keep the greatest element in front; with this order it is the lowest rank
+	auto ranksHigher = [this](const auto& lhs, const auto& rhs) { return entries_.at(lhs).rank > entries_.at(rhs).rank; };
+
+	// Ranks only grow, so an entry already in the heap just moves away from the front
+	if (auto it = std::find(top_.begin(), top_.end(), uuid); it != top_.end())
+	{
+		std::make_heap(top_.begin(), top_.end(), ranksHigher);
+		return;
+	}
+
+	if (top_.size() < capacity_)
+	{
+		top_.push_back(uuid);
+		std::push_heap(top_.begin(), top_.end(), ranksHigher);
+	}
+	else if (capacity_ > 0 && entries_.at(uuid).rank > entries_.at(top_.front()).rank)
+	{
+		std::pop_heap(top_.begin(), top_.end(), ranksHigher);
+		top_.back() = uuid;
+		std::push_heap(top_.begin(), top_.end(), ranksHigher);
+	}
+}
+
+void usageLog::refill()
+{
+	// Entries outside the heap never change rank without passing through offer(), but a removed one
+	// leaves a gap that only the whole map can fill
+	top_.clear();
+	for (const auto& [uuid, state] : entries_)
+	{
+		offer(uuid);
+	}
+}
+
+} // namespace data
\ No newline at end of file
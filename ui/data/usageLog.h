@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include <uuid.h>
+
+#include "data/storage.h"
+
+namespace data
+{
+
+// Use counts and last use times of sent snippets, ranked by frecency: every use adds 1 to a score
+// that halves every halfLife. The log is a file of fixed-size records next to the xml
+// (storage.xml.usage); a use appends the new state of one snippet, so the xml is never rewritten
+// for it. The best entries are kept in a bounded heap, so reading them does not depend on the
+// size of the storage or of the log.
+class usageLog
+{
+public:
+	struct entry
+	{
+		uint32_t count { 0 };
+		int64_t lastUsed { 0 };
+		// log2 of the score plus time / halfLife: grows with every use and never changes
+		// otherwise, so entries compare the same way at any moment
+		double rank { 0 };
+	};
+
+	static constexpr int64_t halfLife = 3 * 24 * 60 * 60;
+
+	explicit usageLog(storage::shared_ptr_t source, size_t capacity = 30);
+	~usageLog();
+
+	usageLog(const usageLog&) = delete;
+	usageLog& operator=(const usageLog&) = delete;
+
+	static std::filesystem::path pathFor(const std::filesystem::path& xmlPath);
+
+	// Replays the log and keeps it open for appending. A log that has grown much larger than the
+	// number of snippets in it is rewritten first.
+	bool open(const std::filesystem::path& xmlPath);
+
+	void recordUse(const uuids::uuid& uuid, int64_t now = currentTime());
+	void forget(const uuids::uuid& uuid);
+
+	// Best first, at most capacity uuids
+	std::vector<uuids::uuid> recent() const;
+	const entry* find(const uuids::uuid& uuid) const;
+	bool empty() const { return top_.empty(); }
+
+	static int64_t currentTime();
+
+private:
+	void onChange(const storage::change& what);
+	void append(const uuids::uuid& uuid, const entry& state);
+	void compact(const std::filesystem::path& path);
+
+	// Puts the entry into the heap when it beats the worst one there
+	void offer(const uuids::uuid& uuid);
+	void refill();
+
+	storage::shared_ptr_t storage_;
+	size_t listenerId_ { 0 };
+	size_t capacity_;
+
+	std::unordered_map<uuids::uuid, entry> entries_;
+	// Min-heap on rank: the front is the first to go when a better entry comes in
+	std::vector<uuids::uuid> top_;
+
+	int fd_ { -1 };
+	size_t records_ { 0 };
+};
+
+} // namespace data
\ No newline at end of file
@@ -1,10 +1,296 @@
 #include "data/xmlStorageManager.h"
-#include "utils/generate_uuid.h"
+#include "data/snapshotCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+#include <unistd.h>
 
 namespace data
 {
+namespace
+{
+// A uuid written by hand may be malformed. One made from the file and the place of the element
+// in it stays the same from start to start, so the usage log, the recent list and the snapshot
+// keep finding the node until the next save writes it into the file; derived tells the caller
+// that the file needs that save.
+uuids::uuid parseUuid(const pugi::xml_node& node, const std::string& fileName, bool* derived = nullptr)
+{
+	auto parsed = uuids::uuid::from_string(std::string_view(node.attribute("uuid").as_string()));
+	if (parsed)
+	{
+		return parsed.value();
+	}
+	if (derived)
+	{
+		*derived = true;
+	}
+	return uuids::uuid_name_generator(uuids::uuid_namespace_url)(fileName + "#" + std::to_string(node.offset_debug()));
+}
+
+// The name a file goes by in parseUuid: storage.xml, storage.d/<shard>.xml
+std::string sourceName(const std::filesystem::path& file)
+{
+	return (file.parent_path().filename() / file.filename()).string();
+}
+
+uint64_t toHandle(const pugi::xml_node& node)
+{
+	return reinterpret_cast<uint64_t>(node.internal_object());
+}
+
+pugi::xml_node fromHandle(uint64_t handle)
+{
+	return pugi::xml_node(reinterpret_cast<pugi::xml_node_struct*>(handle));
+}
+
+// A shard written by hand may leave out the uuid of its folder; one made from the file name
+// stays the same from start to start, so the folder keeps its file
+uuids::uuid shardUuid(const pugi::xml_node& folderNode, const std::string& fileName)
+{
+	auto parsed = uuids::uuid::from_string(std::string_view(folderNode.attribute("uuid").as_string()));
+	return parsed ? parsed.value() : uuids::uuid_name_generator(uuids::uuid_namespace_url)(fileName);
+}
+
+// Shard files of a manifest, the listed ones in its order, then the other .xml files of the
+// directory by name
+std::vector<std::string> shardFileNames(const pugi::xml_node& rootNode, const std::filesystem::path& shardDir)
+{
+	std::vector<std::string> names;
+	for (auto shardNode : rootNode.children("shard"))
+	{
+		names.push_back(shardNode.attribute("file").as_string());
+	}
+
+	std::vector<std::string> dropped;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(shardDir, ec))
+	{
+		auto name = entry.path().filename().string();
+		if (entry.path().extension() == ".xml" && std::find(names.begin(), names.end(), name) == names.end())
+		{
+			dropped.push_back(std::move(name));
+		}
+	}
+	std::sort(dropped.begin(), dropped.end());
+	names.insert(names.end(), dropped.begin(), dropped.end());
+	return names;
+}
+
+// Written aside, synced and renamed over the target, so a killed process leaves either the
+// old or the new file, never a truncated one
+bool saveAtomically(const pugi::xml_document& doc, const std::string& filename)
+{
+	auto tmpName = filename + ".tmp";
+	auto file = std::fopen(tmpName.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	pugi::xml_writer_file writer(file);
+	doc.save(writer);
+	bool written = std::fflush(file) == 0 && ::fsync(::fileno(file)) == 0;
+	written = std::fclose(file) == 0 && written;
+
+	std::error_code ec;
+	if (written)
+	{
+		std::filesystem::rename(tmpName, filename, ec);
+	}
+	if (!written || ec)
+	{
+		std::filesystem::remove(tmpName, ec);
+		return false;
+	}
+	return true;
+}
+
+// Owns the text of a file while the storage still refers to it. The document is parsed in
+// place, so every snippet content is a NUL-terminated string inside the text and a content
+// handle is its offset. Subtree handles are <folder> nodes; the document is freed once every
+// placeholder made from it has been filled, and only the text stays.
+class xmlDocumentSource
+: public storage::contentSource
+, public storage::subtreeSource
+{
+public:
+	// repaired is set whenever a malformed uuid had to be replaced, on whichever thread fills a placeholder
+	xmlDocumentSource(bool lazyContent, std::atomic<bool>& repaired)
+	: lazyContent_(lazyContent)
+	, repaired_(repaired)
+	{ }
+
+	bool load(const std::filesystem::path& file)
+	{
+		name_ = sourceName(file);
+		std::ifstream in(file, std::ios::binary);
+		if (!in)
+		{
+			return false;
+		}
+		text_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		document_ = std::make_unique<pugi::xml_document>();
+		return !in.bad() && document_->load_buffer_inplace(text_.data(), text_.size());
+	}
+
+	pugi::xml_node child(const char* name) const
+	{
+		return document_ ? document_->child(name) : pugi::xml_node();
+	}
+
+	uuids::uuid parseUuid(const pugi::xml_node& node) const
+	{
+		bool derived = false;
+		auto uuid = data::parseUuid(node, name_, &derived);
+		if (derived)
+		{
+			repaired_ = true;
+		}
+		return uuid;
+	}
+
+	std::string_view resolve(uint64_t handle) const override
+	{
+		return text_.data() + handle;
+	}
+
+	void populate(storage& target, const storage::folder_shared_ptr_t& placeholder, uint64_t handle) const override
+	{
+		populate(target, placeholder, fromHandle(handle));
+		placeholders_--;
+		releaseDocument();
+	}
+
+	void populate(storage& target, const storage::folder_shared_ptr_t& folder, const pugi::xml_node& xmlNode) const
+	{
+		// Сначала сниппеты, затем вложенные папки (пока только заглушки)
+		populateSnippets(target, folder, xmlNode);
+
+		for (auto subFolderNode : xmlNode.children("folder"))
+		{
+			target.insertFolder(folder, makeFolder(target, subFolderNode, parseUuid(subFolderNode)));
+		}
+	}
+
+	void populateSnippets(storage& target, const storage::folder_shared_ptr_t& folder, const pugi::xml_node& xmlNode) const
+	{
+		for (auto snippetNode : xmlNode.children("snippet"))
+		{
+			target.insertSnippet(folder, parseSnippet(target, snippetNode));
+		}
+	}
+
+	// A placeholder for a <folder> node of this document
+	storage::folder_shared_ptr_t makeFolder(storage& target, const pugi::xml_node& folderNode, const uuids::uuid& uuid) const
+	{
+		placeholders_++;
+		return target.makeLazyFolder(folderNode.attribute("name").as_string(), uuid, this, toHandle(folderNode));
+	}
+
+	// Frees the document when no placeholder needs it anymore, and the text too when no
+	// content points into it. Called by the loader once it is done with the document.
+	void releaseDocument() const
+	{
+		if (placeholders_ > 0)
+		{
+			return;
+		}
+		document_.reset();
+		if (!lazyContent_)
+		{
+			text_ = {};
+		}
+	}
+
+private:
+	storage::snippet_shared_ptr_t parseSnippet(storage& target, const pugi::xml_node& snippetNode) const
+	{
+		auto title = snippetNode.child_value("title");
+		auto content = snippetNode.child_value("content");
+		auto uuid = parseUuid(snippetNode);
+		bool from_file = snippetNode.attribute("from_file").as_bool(false);
+
+		// pugixml converts a file that is not UTF-8 into a buffer of its own, and an empty
+		// content is a static string; those are copied like in eager mode
+		if (lazyContent_ && content >= text_.data() && content < text_.data() + text_.size())
+		{
+			return target.makeLazySnippet(title, this, content - text_.data(), uuid, from_file);
+		}
+
+		// Strings go from the pugixml buffer straight into the storage arena
+		return target.makeSnippet(title, content, uuid, from_file);
+	}
+
+	bool lazyContent_;
+	std::atomic<bool>& repaired_;
+	std::string name_;
+	// Guarded by the storage lock, like every populate()
+	mutable std::vector<char> text_;
+	mutable std::unique_ptr<pugi::xml_document> document_;
+	mutable size_t placeholders_ { 0 };
+};
+
+// Shards are parsed in parallel, with at most one thread per core. A file that does not parse
+// or has no <folder> root comes back empty.
+std::vector<std::shared_ptr<xmlDocumentSource>> parseShards(const std::filesystem::path& shardDir, const std::vector<std::string>& names, bool lazyContent,
+	std::atomic<bool>& repaired)
+{
+	std::vector<std::shared_ptr<xmlDocumentSource>> sources(names.size());
+	std::atomic<size_t> next { 0 };
+	auto worker = [&]()
+	{
+		for (size_t i; (i = next++) < names.size();)
+		{
+			auto source = std::make_shared<xmlDocumentSource>(lazyContent, repaired);
+			if (source->load(shardDir / names[i]) && source->child("folder"))
+			{
+				sources[i] = std::move(source);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), names.size());
+	for (size_t i = 1; i < workers; i++)
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : pool)
+	{
+		thread.join();
+	}
+	return sources;
+}
+
+// Bytes of titles and contents in the subtree of a folder of the image
+size_t subtreeBytes(const storageImage& image, uint32_t folder)
+{
+	size_t bytes = 0;
+	for (auto i = folder; i < image.folders[folder].subtreeEnd; i++)
+	{
+		const auto& owner = image.folders[i];
+		for (auto j = owner.firstSnippet; j < owner.firstSnippet + owner.snippetCount; j++)
+		{
+			bytes += image.snippets[j].title.size() + image.snippets[j].content().size();
+		}
+	}
+	return bytes;
+}
+} // namespace
+
 xmlStorageManager::xmlStorageManager()
 : storage_(std::make_shared<storage>())
+, contentIndex_(std::make_unique<trigramIndex>(storage_))
+, usage_(std::make_unique<usageLog>(storage_))
 { }
 
 storage::shared_ptr_t xmlStorageManager::getStorage() const
@@ -14,138 +300,498 @@ storage::shared_ptr_t xmlStorageManager::getStorage() const
 
 bool xmlStorageManager::parse(const std::string& filename)
 {
-	pugi::xml_document doc;
-	if (!doc.load_file(filename.c_str()))
+	auto source = std::make_shared<xmlDocumentSource>(lazyContent_, uuidsRepaired_);
+	if (!source->load(filename))
 	{
 		return false;
 	}
 
-	auto rootNode = doc.child("storage");
+	auto rootNode = source->child("storage");
 	if (!rootNode)
 	{
 		return false;
 	}
 
-	// Сначала парсим сниппеты корневого уровня
-	for (auto snippetNode : rootNode.children("snippet"))
+	auto shardDir = shardDirFor(filename);
+	auto shardNames = shardFileNames(rootNode, shardDir);
+	auto shards = parseShards(shardDir, shardNames, lazyContent_, uuidsRepaired_);
+
+	std::lock_guard lock(saveMutex_);
+	shardFiles_.clear();
+	shardFilesKnown_ = true;
+
+	// Top-level folders in the order of the manifest, whether inline or in a shard
+	auto root = storage_->root();
+	source->populateSnippets(*storage_, root, rootNode);
+	size_t shard = 0;
+	auto insertShard = [&]()
+	{
+		if (!shards[shard])
+		{
+			return;
+		}
+		auto folderNode = shards[shard]->child("folder");
+		auto uuid = shardUuid(folderNode, shardNames[shard]);
+		// A folder that is already in the tree keeps its place, the file is left alone
+		if (!storage_->findFolder(uuid))
+		{
+			storage_->insertFolder(root, shards[shard]->makeFolder(*storage_, folderNode, uuid));
+			shardFiles_.emplace(uuid, shardNames[shard]);
+		}
+	};
+	for (auto node : rootNode.children())
+	{
+		if (std::string_view(node.name()) == "folder")
+		{
+			storage_->insertFolder(root, source->makeFolder(*storage_, node, source->parseUuid(node)));
+		}
+		else if (std::string_view(node.name()) == "shard" && shard < shards.size())
+		{
+			insertShard();
+			shard++;
+		}
+	}
+	for (; shard < shards.size(); shard++)
+	{
+		insertShard();
+	}
+
+	if (!lazySubtrees_)
+	{
+		storage_->loadAll();
+	}
+	assert(storage_->checkIndex());
+
+	// A source is only needed while something still points into it: a placeholder into its
+	// document or a lazy content into its text
+	shards.push_back(std::move(source));
+	for (auto& fileSource : shards)
 	{
-		auto snippet = parseSnippet(snippetNode);
-		storage_->root()->snippets_.push_back(snippet);
+		if (fileSource)
+		{
+			fileSource->releaseDocument();
+			if (lazyContent_ || !storage_->fullyLoaded())
+			{
+				storage_->retainBuffer(std::move(fileSource));
+			}
+		}
 	}
 
-	// Затем парсим папки
-	parseFolder(rootNode, storage_->root());
+	savedGeneration_ = storage_->generation();
 	return true;
 }
 
-bool xmlStorageManager::dump(const std::string& filename)
+bool xmlStorageManager::load(const std::string& filename)
 {
-	pugi::xml_document doc;
-	auto storageNode = doc.append_child("storage");
+	usage_->open(filename);
 
-	// Сначала дампим сниппеты корневого уровня
-	for (const auto& snippet : storage_->root()->snippets_)
+	// Stamp taken before parsing, so an xml changed meanwhile makes the snapshot stale
+	auto xmlStamp = stampOf(filename);
+	if (!xmlStamp)
 	{
-		auto snippetNode = storageNode.append_child("snippet");
-		dumpSnippet(snippetNode, snippet);
+		return false;
 	}
 
-	// Затем дампим папки
-	dumpFolder(storageNode, storage_->root());
+	if (snapshotCache::load(filename, *xmlStamp, *storage_, lazyContent_, lazySubtrees_))
+	{
+		assert(storage_->checkIndex());
+		savedGeneration_ = storage_->generation();
+		contentIndex_->load(filename, *xmlStamp);
+		return true;
+	}
 
-	if (!doc.save_file(filename.c_str()))
+	if (!parse(filename))
 	{
 		return false;
 	}
 
+	// The snapshot needs the whole tree. This start pays for it, the following ones load lazily.
+	snapshotCache::write(filename, storageImage::capture(*storage_), *xmlStamp);
+	contentIndex_->load(filename, *xmlStamp);
 	return true;
 }
 
-storage::snippet_shared_ptr_t xmlStorageManager::parseSnippet(const pugi::xml_node& snippetNode)
+void xmlStorageManager::record(const storage::change& what)
 {
-	std::string title = snippetNode.child_value("title");
-	std::string content = snippetNode.child_value("content");
-	std::string uuidStr = snippetNode.attribute("uuid").as_string();
-	bool from_file = snippetNode.attribute("from_file").as_bool(false);
+	// Only notes the files; flush() captures the tree on the saver thread
+	markDirty(what);
+}
 
-	uuids::uuid snippetUuid;
-	try
+void xmlStorageManager::markDirty(const storage::change& what)
+{
+	// The folder the change is in: a deleted node is gone, the folder that held it is not
+	storage::folder_shared_ptr_t folder;
+	switch (what.what)
 	{
-		snippetUuid = uuids::uuid::from_string(uuidStr).value();
+	case storage::change::kind::snippetAdded:
+	case storage::change::kind::snippetEdited:
+		folder = storage_->findSnippetFolder(what.uuid);
+		break;
+	case storage::change::kind::folderAdded:
+	case storage::change::kind::folderRenamed:
+		folder = storage_->findFolder(what.uuid);
+		break;
+	case storage::change::kind::snippetDeleted:
+	case storage::change::kind::folderDeleted:
+		folder = storage_->findFolder(what.parent);
+		break;
 	}
-	catch (...)
+
+	auto root = storage_->root();
+	std::lock_guard lock(pendingMutex_);
+	changed_ = true;
+	if (!folder)
 	{
-		snippetUuid = utils::generate_uuid();
+		dirtyAll_ = true;
+		return;
 	}
 
-	auto snippet = std::make_shared<storage::snippet_t>();
-	snippet->title = title;
-	snippet->content = content;
-	snippet->uuid = snippetUuid;
-	snippet->from_file = from_file;
+	// Up to the top-level folder, whose file holds the change; the manifest lists new ones
+	while (folder != root)
+	{
+		auto parent = folder->parent_.lock();
+		if (parent == root)
+		{
+			break;
+		}
+		folder = parent;
+	}
+	if (folder == root || what.what == storage::change::kind::folderAdded)
+	{
+		dirtyShards_.insert(uuids::uuid {});
+	}
+	if (folder != root)
+	{
+		dirtyShards_.insert(folder->uuid_);
+	}
+}
 
-	return snippet;
+bool xmlStorageManager::flush(const std::string& filename)
+{
+	std::unordered_set<uuids::uuid> dirty;
+	bool dirtyAll = false;
+	{
+		std::lock_guard lock(pendingMutex_);
+		// Every file, since only a full walk would find the nodes that got a new uuid
+		if (uuidsRepaired_.exchange(false))
+		{
+			changed_ = true;
+			dirtyAll_ = true;
+		}
+		if (!std::exchange(changed_, false))
+		{
+			return true;
+		}
+		dirty.swap(dirtyShards_);
+		std::swap(dirtyAll, dirtyAll_);
+	}
+
+	// One capture per burst of edits, under the lock the UI thread holds while it reads, so
+	// filling the placeholders here does not race with it. The views it copies stay valid after.
+	std::optional<storageImage> image;
+	{
+		auto lock = storage_->lock();
+		image = storageImage::capture(*storage_);
+	}
+	if (save(filename, *image, dirtyAll ? nullptr : &dirty))
+	{
+		return true;
+	}
+
+	// Written with the next change
+	std::lock_guard lock(pendingMutex_);
+	changed_ = true;
+	dirtyShards_.merge(dirty);
+	dirtyAll_ = dirtyAll_ || dirtyAll;
+	return false;
 }
 
-void xmlStorageManager::dumpSnippet(pugi::xml_node& snippetNode, const storage::snippet_shared_ptr_t& snippet)
+bool xmlStorageManager::saveContentIndex(const std::string& filename)
 {
-	snippetNode.append_attribute("uuid").set_value(uuids::to_string(snippet->uuid).c_str());
-	snippetNode.append_attribute("from_file").set_value(snippet->from_file);
+	auto xmlStamp = stampOf(filename);
+	return xmlStamp && contentIndex_->save(filename, *xmlStamp);
+}
 
-	snippetNode.append_child("title").text().set(snippet->title.c_str());
-	snippetNode.append_child("content").text().set(snippet->content.c_str());
+bool xmlStorageManager::dump(const std::string& filename)
+{
+	return save(filename, storageImage::capture(*storage_));
 }
 
-void xmlStorageManager::parseFolder(const pugi::xml_node& xmlNode, std::shared_ptr<storage::folder> folder)
+bool xmlStorageManager::save(const std::string& filename, const storageImage& image)
 {
-	for (auto subFolderNode : xmlNode.children("folder"))
+	return save(filename, image, nullptr);
+}
+
+bool xmlStorageManager::save(const std::string& filename, const storageImage& image, const std::unordered_set<uuids::uuid>* dirty)
+{
+	std::lock_guard lock(saveMutex_);
+	if (!shardFilesKnown_)
 	{
-		std::string folderName = subFolderNode.attribute("name").as_string();
-		std::string folderUuidStr = subFolderNode.attribute("uuid").as_string();
+		readShardFiles(filename);
+	}
+
+	auto isDirty = [dirty](const uuids::uuid& uuid) { return !dirty || dirty->contains(uuid); };
+	bool writeManifest = isDirty(uuids::uuid {});
+
+	// Дочерние папки корня: первая идёт сразу за ним, следующая - за концом поддерева предыдущей
+	std::vector<uint32_t> topLevel;
+	for (auto i = 1u; i < image.folders[0].subtreeEnd; i = image.folders[i].subtreeEnd)
+	{
+		topLevel.push_back(i);
+		// A folder kept in the manifest is written with it
+		if (!shardFiles_.contains(image.folders[i].uuid) && isDirty(image.folders[i].uuid))
+		{
+			writeManifest = true;
+		}
+	}
 
-		uuids::uuid folderUuid;
-		try
+	// Shards first, so the manifest never lists a file that is not there
+	auto shardDir = shardDirFor(filename);
+	std::unordered_map<uuids::uuid, std::string> shardFiles;
+	for (auto i : topLevel)
+	{
+		const auto& folder = image.folders[i];
+		auto known = shardFiles_.find(folder.uuid);
+		if (known == shardFiles_.end() && !(writeManifest && subtreeBytes(image, i) >= shardThreshold_))
 		{
-			folderUuid = uuids::uuid::from_string(folderUuidStr).value();
+			continue;
 		}
-		catch (...)
+
+		auto name = known != shardFiles_.end() ? known->second : uuids::to_string(folder.uuid) + ".xml";
+		if (known == shardFiles_.end() || isDirty(folder.uuid))
 		{
-			folderUuid = utils::generate_uuid();
+			std::error_code ec;
+			std::filesystem::create_directories(shardDir, ec);
+			pugi::xml_document doc;
+			dumpSubFolder(doc, image, i);
+			if (!saveAtomically(doc, (shardDir / name).string()))
+			{
+				return false;
+			}
 		}
+		shardFiles.emplace(folder.uuid, std::move(name));
+	}
 
-		auto newFolder = std::make_shared<storage::folder>(folderName, folderUuid);
-		newFolder->parent_ = folder;
-		folder->subFolders_[folderUuid] = newFolder;
+	if (writeManifest)
+	{
+		pugi::xml_document doc;
+		auto storageNode = doc.append_child("storage");
 
-		// Парсим сниппеты подпапки
-		for (auto snippetNode : subFolderNode.children("snippet"))
+		// Сначала дампим сниппеты корневого уровня, затем папки
+		dumpSnippets(storageNode, image, 0);
+		for (auto i : topLevel)
 		{
-			auto snippet = parseSnippet(snippetNode);
-			newFolder->snippets_.push_back(snippet);
+			auto shard = shardFiles.find(image.folders[i].uuid);
+			if (shard == shardFiles.end())
+			{
+				dumpSubFolder(storageNode, image, i);
+				continue;
+			}
+			auto shardNode = storageNode.append_child("shard");
+			shardNode.append_attribute("file").set_value(shard->second.c_str());
+			shardNode.append_attribute("uuid").set_value(uuids::to_string(image.folders[i].uuid).c_str());
 		}
 
-		// Рекурсивно парсим вложенные папки
-		parseFolder(subFolderNode, newFolder);
+		if (!saveAtomically(doc, filename))
+		{
+			return false;
+		}
 	}
+
+	// Files of deleted folders, now that the manifest no longer lists them
+	for (const auto& [uuid, name] : shardFiles_)
+	{
+		if (!shardFiles.contains(uuid))
+		{
+			std::error_code ec;
+			std::filesystem::remove(shardDir / name, ec);
+		}
+	}
+	shardFiles_ = std::move(shardFiles);
+
+	savedGeneration_ = image.generation;
+	if (auto xmlStamp = stampOf(filename))
+	{
+		snapshotCache::write(filename, image, *xmlStamp);
+	}
+	return true;
 }
 
-void xmlStorageManager::dumpFolder(pugi::xml_node& xmlNode, std::shared_ptr<storage::folder> folder)
+void xmlStorageManager::readShardFiles(const std::string& filename)
 {
-	for (const auto& [uuid, subFolder] : folder->subFolders_)
+	shardFiles_.clear();
+	shardFilesKnown_ = true;
+
+	pugi::xml_document doc;
+	if (!doc.load_file(filename.c_str()))
 	{
-		auto subFolderNode = xmlNode.append_child("folder");
-		subFolderNode.append_attribute("name").set_value(subFolder->name_.c_str());
-		subFolderNode.append_attribute("uuid").set_value(uuids::to_string(subFolder->uuid_).c_str());
+		return;
+	}
+
+	// Same rules as parse(), which never registers a file it did not load: the uuid comes from
+	// the file, and a file whose folder is inline in the manifest or came from an earlier file
+	// is left alone. Runs on the saver thread, so opening every shard here costs no startup time.
+	auto rootNode = doc.child("storage");
+	std::unordered_set<uuids::uuid> inlineFolders;
+	for (auto folderNode : rootNode.children("folder"))
+	{
+		inlineFolders.insert(parseUuid(folderNode, sourceName(filename)));
+	}
 
-		// Дампим сниппеты папки
-		for (const auto& snippet : subFolder->snippets_)
+	auto shardDir = shardDirFor(filename);
+	for (const auto& name : shardFileNames(rootNode, shardDir))
+	{
+		pugi::xml_document shard;
+		if (!shard.load_file((shardDir / name).c_str()) || !shard.child("folder"))
 		{
-			auto snippetNode = subFolderNode.append_child("snippet");
-			dumpSnippet(snippetNode, snippet);
+			continue;
 		}
 
-		// Рекурсивно дампим вложенные папки
-		dumpFolder(subFolderNode, subFolder);
+		auto uuid = shardUuid(shard.child("folder"), name);
+		if (!inlineFolders.contains(uuid))
+		{
+			shardFiles_.emplace(uuid, name);
+		}
 	}
 }
+
+std::filesystem::path xmlStorageManager::shardDirFor(const std::filesystem::path& xmlPath)
+{
+	auto path = xmlPath;
+	path.replace_extension(".d");
+	return path;
+}
+
+std::optional<snapshotCache::fileStamp> xmlStorageManager::stampOf(const std::filesystem::path& xmlPath)
+{
+	auto stamp = snapshotCache::stampOf(xmlPath);
+	auto shardDir = shardDirFor(xmlPath);
+	auto dirStamp = snapshotCache::stampOf(shardDir);
+	if (!stamp || !dirStamp)
+	{
+		return stamp;
+	}
+
+	// Adding, removing or renaming a shard moves the mtime of the directory
+	stamp->mtime = std::max(stamp->mtime, dirStamp->mtime);
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(shardDir, ec))
+	{
+		if (entry.path().extension() != ".xml")
+		{
+			continue;
+		}
+		if (auto shardStamp = snapshotCache::stampOf(entry.path()))
+		{
+			stamp->size += shardStamp->size;
+			stamp->mtime = std::max(stamp->mtime, shardStamp->mtime);
+		}
+	}
+	return stamp;
+}
+
+bool xmlStorageManager::hasUnsavedChanges() const
+{
+	return storage_->generation() != savedGeneration_;
+}
+
+void xmlStorageManager::dumpSnippets(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder)
+{
+	const auto& owner = image.folders[folder];
+	for (auto i = owner.firstSnippet; i < owner.firstSnippet + owner.snippetCount; i++)
+	{
+		const auto& snippet = image.snippets[i];
+		auto snippetNode = xmlNode.append_child("snippet");
+		snippetNode.append_attribute("uuid").set_value(uuids::to_string(snippet.uuid).c_str());
+		snippetNode.append_attribute("from_file").set_value(snippet.from_file);
+
+		snippetNode.append_child("title").text().set(snippet.title.data(), snippet.title.size());
+		auto content = snippet.content();
+		snippetNode.append_child("content").text().set(content.data(), content.size());
+	}
+}
+
+void xmlStorageManager::dumpFolder(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder)
+{
+	// Дочерние папки: первая идёт сразу за родителем, следующая - за концом поддерева предыдущей
+	for (auto i = folder + 1; i < image.folders[folder].subtreeEnd; i = image.folders[i].subtreeEnd)
+	{
+		dumpSubFolder(xmlNode, image, i);
+	}
+}
+
+void xmlStorageManager::dumpSubFolder(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder)
+{
+	const auto& subFolder = image.folders[folder];
+	auto subFolderNode = xmlNode.append_child("folder");
+	subFolderNode.append_attribute("name").set_value(subFolder.name.data(), subFolder.name.size());
+	subFolderNode.append_attribute("uuid").set_value(uuids::to_string(subFolder.uuid).c_str());
+
+	// Дампим сниппеты папки и рекурсивно вложенные папки
+	dumpSnippets(subFolderNode, image, folder);
+	dumpFolder(subFolderNode, image, folder);
+}
+
+bool xmlStorageManager::parse(const std::string& filename, flatStorage& target)
+{
+	pugi::xml_document doc;
+	if (!doc.load_file(filename.c_str()))
+	{
+		return false;
+	}
+
+	auto rootNode = doc.child("storage");
+	if (!rootNode)
+	{
+		return false;
+	}
+
+	parseFolder(rootNode, target, target.root(), sourceName(filename));
+	return true;
+}
+
+bool xmlStorageManager::dump(const std::string& filename, const flatStorage& source)
+{
+	pugi::xml_document doc;
+	auto storageNode = doc.append_child("storage");
+	dumpFolder(storageNode, source, source.root());
+	return saveAtomically(doc, filename);
+}
+
+void xmlStorageManager::parseFolder(const pugi::xml_node& xmlNode, flatStorage& target, flatStorage::index_t folder, const std::string& fileName)
+{
+	for (auto snippetNode : xmlNode.children("snippet"))
+	{
+		target.insertSnippet(folder, snippetNode.child_value("title"), snippetNode.child_value("content"), parseUuid(snippetNode, fileName),
+			snippetNode.attribute("from_file").as_bool(false));
+	}
+
+	for (auto subFolderNode : xmlNode.children("folder"))
+	{
+		auto newFolder = target.insertFolder(folder, subFolderNode.attribute("name").as_string(), parseUuid(subFolderNode, fileName));
+		parseFolder(subFolderNode, target, newFolder, fileName);
+	}
+}
+
+void xmlStorageManager::dumpFolder(pugi::xml_node& xmlNode, const flatStorage& source, flatStorage::index_t folder)
+{
+	source.forEachSnippet(folder,
+		[&xmlNode](flatStorage::index_t, const flatStorage::snippet& snippet)
+		{
+			auto snippetNode = xmlNode.append_child("snippet");
+			snippetNode.append_attribute("uuid").set_value(uuids::to_string(snippet.uuid).c_str());
+			snippetNode.append_attribute("from_file").set_value(snippet.from_file);
+			snippetNode.append_child("title").text().set(snippet.title.data(), snippet.title.size());
+			snippetNode.append_child("content").text().set(snippet.content.data(), snippet.content.size());
+		});
+
+	source.forEachSubFolder(folder,
+		[this, &xmlNode, &source](flatStorage::index_t index, const flatStorage::folder& subFolder)
+		{
+			auto subFolderNode = xmlNode.append_child("folder");
+			subFolderNode.append_attribute("name").set_value(subFolder.name_.data(), subFolder.name_.size());
+			subFolderNode.append_attribute("uuid").set_value(uuids::to_string(subFolder.uuid_).c_str());
+			dumpFolder(subFolderNode, source, index);
+		});
+}
 } // namespace data
\ No newline at end of file
@@ -1,29 +1,136 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <pugixml.hpp>
 
 #include "data/storage.h"
+#include "data/storageBackend.h"
+#include "data/flatStorage.h"
+#include "data/snapshotCache.h"
+#include "data/storageImage.h"
+#include "data/trigramIndex.h"
+#include "data/usageLog.h"
 
 namespace data
 {
-class xmlStorageManager
+// The storage as xml. data/storage.xml is the manifest: the root-level snippets, the small
+// top-level folders and, in order among them, a <shard> entry for every top-level folder kept
+// in a file of its own in data/storage.d. A shard is a <folder> element as it would appear in
+// the manifest, so a folder can be shared by dropping its file into the directory; files the
+// manifest does not list yet are loaded after the listed ones. Shards are parsed in parallel,
+// and a flush rewrites only the files that hold a change.
+//
+// A binary snapshot, a content index and the usage log are kept next to storage.xml.
+class xmlStorageManager : public storageBackend
 {
 public:
 	xmlStorageManager();
-	storage::shared_ptr_t getStorage() const;
+	storage::shared_ptr_t getStorage() const override;
 
 	bool parse(const std::string& filename);
 	bool dump(const std::string& filename);
 
+	// Writes a captured image; unlike dump() this may run on another thread than the storage.
+	// Every file is replaced atomically and the snapshot is refreshed from the same image.
+	bool save(const std::string& filename, const storageImage& image);
+
+	// Startup path: reads the binary snapshot when it is still valid, otherwise parses the xml
+	// and refreshes the snapshot for the next start
+	bool load(const std::string& filename) override;
+
+	// record() notes which files the change touched, flush() captures the tree once on the
+	// saver thread and saves those files
+	void record(const storage::change& what) override;
+	bool flush(const std::string& filename) override;
+	bool write(const std::string& filename, const storageImage& image) override { return save(filename, image); }
+	// Saves the content index, unless the last flush failed: the index would hold edits the xml
+	// does not, under a stamp the next start trusts
+	void close(const std::string& filename) override
+	{
+		if (!hasUnsavedChanges())
+		{
+			saveContentIndex(filename);
+		}
+	}
+
+	contentSearch& getContentSearch() override { return *contentIndex_; }
+
+	// Content search over the storage; built on first use unless load() found a valid index file
+	trigramIndex& getContentIndex() { return *contentIndex_; }
+	// Stores the index for the xml file as it is now, so call it after the last save
+	bool saveContentIndex(const std::string& filename);
+
+	// Use counts of sent snippets, opened by load()
+	usageLog& getUsage() override { return *usage_; }
+
+	// True when the storage changed since the last successful parse or dump
+	bool hasUnsavedChanges() const;
+
+	// Lazy mode (default): snippet contents stay in the text of the loaded file or the mapped
+	// snapshot and are only read when a snippet is sent, shown or edited
+	void setLazyContent(bool lazy) { lazyContent_ = lazy; }
+
+	// Lazy mode (default): only the root level is built on load, every other folder is a
+	// placeholder until storage::folderDown enters it
+	void setLazySubtrees(bool lazy) { lazySubtrees_ = lazy; }
+
+	// A top-level folder holding at least this many bytes of titles and contents moves to a
+	// shard the next time the manifest is written; 0 moves every top-level folder, SIZE_MAX
+	// (the default) none. Shards never move back into the manifest.
+	void setShardThreshold(size_t bytes) { shardThreshold_ = bytes; }
+
+	// data/storage.d for data/storage.xml
+	static std::filesystem::path shardDirFor(const std::filesystem::path& xmlPath);
+	// Total size and latest mtime of the manifest, the shard directory and the shards in it;
+	// what the snapshot and the content index are checked against
+	static std::optional<snapshotCache::fileStamp> stampOf(const std::filesystem::path& xmlPath);
+
+	// Same file format without shards, loaded into / saved from the index-based layout
+	bool parse(const std::string& filename, flatStorage& target);
+	bool dump(const std::string& filename, const flatStorage& source);
+
 private:
-	storage::snippet_shared_ptr_t parseSnippet(const pugi::xml_node& snippetNode);
-	void dumpSnippet(pugi::xml_node& snippetNode, const storage::snippet_shared_ptr_t& snippet);
-	void parseFolder(const pugi::xml_node& xmlNode, std::shared_ptr<storage::folder> folder);
-	void dumpFolder(pugi::xml_node& xmlNode, std::shared_ptr<storage::folder> folder);
+	// dirty holds the top-level folders changed since the last save and the nil uuid for the
+	// manifest itself; without it every file is written
+	bool save(const std::string& filename, const storageImage& image, const std::unordered_set<uuids::uuid>* dirty);
+	// After a snapshot load the shard files are only known once a save needs them
+	void readShardFiles(const std::string& filename);
+	void markDirty(const storage::change& what);
+
+	void dumpSnippets(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder);
+	void dumpFolder(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder);
+	void dumpSubFolder(pugi::xml_node& xmlNode, const storageImage& image, uint32_t folder);
+	void parseFolder(const pugi::xml_node& xmlNode, flatStorage& target, flatStorage::index_t folder, const std::string& fileName);
+	void dumpFolder(pugi::xml_node& xmlNode, const flatStorage& source, flatStorage::index_t folder);
 
 	storage::shared_ptr_t storage_;
+	std::unique_ptr<trigramIndex> contentIndex_;
+	std::unique_ptr<usageLog> usage_;
+	std::atomic<uint64_t> savedGeneration_ { 0 };
+	std::mutex pendingMutex_;
+	bool changed_ { false };
+	// A malformed uuid was replaced while reading the xml; the next flush writes the new one
+	std::atomic<bool> uuidsRepaired_ { false };
+	std::unordered_set<uuids::uuid> dirtyShards_;
+	bool dirtyAll_ { false };
+
+	// Guards the shard bookkeeping; save() runs on the saver thread
+	std::mutex saveMutex_;
+	// File name in the shard directory of every top-level folder kept in a shard
+	std::unordered_map<uuids::uuid, std::string> shardFiles_;
+	bool shardFilesKnown_ { false };
+	size_t shardThreshold_ { SIZE_MAX };
+
+	bool lazyContent_ { true };
+	bool lazySubtrees_ { true };
 };
 } // namespace data
\ No newline at end of file
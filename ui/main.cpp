@@ -1,8 +1,13 @@
 #include "browser/storageBrowser.h"
+#include "data/storageSaver.h"
+#include "data/storageBackend.h"
 #include "data/xmlStorageManager.h"
+#include "server/protocol.h"
+#include "server/snippetServer.h"
 #include "utils/exePathManager.h"
-#include "utils/finally.h"
+#include "utils/send_to_tmux.h"
 
+#include <cstdlib>
 #include <string>
 #include <filesystem>
 
@@ -11,15 +16,76 @@ int main(int argc, char* argv[])
 	std::string paneToSendSnippet(argv[1]);
 
 	utils::exePathManager::getInstance().initialize(argv[0]);
-	data::xmlStorageManager xmlStorage;
-	xmlStorage.parse(utils::exePathManager::getInstance().getStoragePath());
-	auto xmlStorageDumpCallback = [&xmlStorage]()
+
+	// Copies a storage between locations and backends: --migrate data/storage.xml data/storage.db
+	if (paneToSendSnippet == "--migrate")
+	{
+		return argc == 4 && data::migrateStorage(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	// Attaches while the storage loads; sends then go over the open connection
+	utils::openTmuxControl();
+	if (auto bracketed = std::getenv("SNIPPETS_BRACKETED_PASTE"))
+	{
+		utils::setBracketedPaste(std::string(bracketed) == "on");
+	}
+
+	// SNIPPETS_BACKEND=sqlite keeps the storage in data/storage.db; the first start copies
+	// storage.xml into it
+	std::string storagePath = utils::exePathManager::getInstance().getStoragePath();
+	if (auto backendName = std::getenv("SNIPPETS_BACKEND"); backendName && std::string(backendName) == "sqlite")
+	{
+		std::string databasePath = utils::exePathManager::getInstance().getDatabasePath();
+		if (!std::filesystem::exists(databasePath) && std::filesystem::exists(storagePath))
+		{
+			data::migrateStorage(storagePath, databasePath);
+		}
+		storagePath = databasePath;
+	}
+
+	auto backend = data::makeStorageBackend(storagePath);
+	// SNIPPETS_SHARD_SIZE=64 moves every top-level folder of 64 KiB or more into data/storage.d
+	// the next time storage.xml is written; without it the xml stays one file
+	if (auto shardSize = std::getenv("SNIPPETS_SHARD_SIZE"); shardSize && *shardSize)
+	{
+		if (auto xml = dynamic_cast<data::xmlStorageManager*>(backend.get()))
+		{
+			xml->setShardThreshold(std::strtoull(shardSize, nullptr, 10) * 1024);
+		}
+	}
+	backend->load(storagePath);
+
+	// Next to a daemon busy with another window: browse and send, but leave every write of the
+	// storage, the content index and the usage log to the daemon
+	if (paneToSendSnippet == "--read-only" && argc == 3)
+	{
+		ui::runStorageBrowser(backend->getStorage(), argv[2], &backend->getContentSearch(), nullptr, nullptr, true);
+		utils::closeTmuxControl();
+		return 0;
+	}
+
+	// Edits are written in the background as they happen; leaving main only waits for
+	// the last pending write, if there is one, and fails when it could not be saved
+	data::storageSaver storageSaver(*backend, storagePath);
+
+	// Resident mode: keep the storage loaded and serve tmux-snippets-client until it asks to quit
+	if (paneToSendSnippet == "--daemon")
+	{
+		server::snippetServer snippetServer(*backend);
+		if (!snippetServer.listen(server::socketPath()))
+		{
+			return 1;
+		}
+		snippetServer.run();
+	}
+	else
 	{
-		xmlStorage.dump(utils::exePathManager::getInstance().getStoragePath());
-	};
-	utils::finally xmlStorageDump(xmlStorageDumpCallback);
+		ui::runStorageBrowser(backend->getStorage(), paneToSendSnippet, &backend->getContentSearch(), &backend->getUsage());
+	}
 
-	ui::runStorageBrowser(xmlStorage.getStorage(), paneToSendSnippet);
+	bool saved = storageSaver.stop();
+	backend->close(storagePath);
+	utils::closeTmuxControl();
 
-	return 0;
+	return saved ? 0 : 1;
 }
\ No newline at end of file
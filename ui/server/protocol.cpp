@@ -0,0 +1,228 @@
+#include "server/protocol.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace server
+{
+namespace
+{
+constexpr size_t maxFds = 4;
+
+bool toAddress(const std::filesystem::path& path, sockaddr_un& address)
+{
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	const auto& native = path.native();
+	if (native.empty() || native.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+	return true;
+}
+
+// Probes, replaces and binds the socket; the caller holds its lock
+int bindLocked(const std::filesystem::path& path, const sockaddr_un& address)
+{
+	// A socket nobody answers on is left over from a daemon that died
+	if (int running = connectTo(path); running >= 0)
+	{
+		::close(running);
+		return -1;
+	}
+	::unlink(path.c_str());
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	auto mask = ::umask(0077);
+	bool bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+	::umask(mask);
+
+	if (!bound || ::listen(fd, 8) != 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+} // namespace
+
+std::filesystem::path socketPath()
+{
+	if (auto runtimeDir = std::getenv("XDG_RUNTIME_DIR"); runtimeDir && *runtimeDir)
+	{
+		return std::filesystem::path(runtimeDir) / "tmux-snippets.sock";
+	}
+
+	// Anyone can create the directory first; only a private one of ours is trusted with the socket
+	auto directory = std::filesystem::path("/tmp") / ("tmux-snippets-" + std::to_string(::getuid()));
+	::mkdir(directory.c_str(), 0700);
+
+	struct stat status;
+	if (::lstat(directory.c_str(), &status) != 0 || !S_ISDIR(status.st_mode) || status.st_uid != ::getuid()
+		|| (status.st_mode & 0777) != 0700)
+	{
+		return {};
+	}
+	return directory / "daemon.sock";
+}
+
+int connectTo(const std::filesystem::path& path)
+{
+	sockaddr_un address;
+	if (!toAddress(path, address))
+	{
+		return -1;
+	}
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int listenOn(const std::filesystem::path& path, int& lock)
+{
+	sockaddr_un address;
+	if (!toAddress(path, address))
+	{
+		return -1;
+	}
+
+	// Two daemons starting together would otherwise both find the socket dead and unlink
+	// each other's
+	lock = ::open((path.string() + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (lock < 0)
+	{
+		return -1;
+	}
+	int fd = ::flock(lock, LOCK_EX | LOCK_NB) == 0 ? bindLocked(path, address) : -1;
+	if (fd < 0)
+	{
+		::close(lock);
+		lock = -1;
+	}
+	return fd;
+}
+
+bool peerIsSameUser(int socket)
+{
+	ucred credentials {};
+	socklen_t length = sizeof(credentials);
+	return ::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == ::getuid();
+}
+
+bool sendLine(int socket, const std::string& line, const std::vector<int>& fds)
+{
+	auto message = line + '\n';
+	iovec data { message.data(), message.size() };
+
+	msghdr header {};
+	header.msg_iov = &data;
+	header.msg_iovlen = 1;
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxFds)] {};
+	if (!fds.empty() && fds.size() <= maxFds)
+	{
+		header.msg_control = control;
+		header.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+		auto cmsg = CMSG_FIRSTHDR(&header);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+		std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+	}
+
+	// The fds go with the first chunk, the rest of a long line is plain data
+	auto sent = ::sendmsg(socket, &header, MSG_NOSIGNAL);
+	if (sent <= 0)
+	{
+		return false;
+	}
+
+	for (size_t offset = sent; offset < message.size(); offset += sent)
+	{
+		sent = ::send(socket, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+		if (sent <= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool receiveLine(int socket, std::string& line, std::vector<int>* fds)
+{
+	line.clear();
+
+	// Byte by byte, so nothing after the newline is consumed; requests are a few dozen bytes
+	while (true)
+	{
+		char ch = 0;
+		iovec data { &ch, 1 };
+
+		msghdr header {};
+		header.msg_iov = &data;
+		header.msg_iovlen = 1;
+
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxFds)] {};
+		header.msg_control = control;
+		header.msg_controllen = sizeof(control);
+
+		auto received = ::recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg))
+		{
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			{
+				continue;
+			}
+
+			auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (size_t i = 0; i < count; i++)
+			{
+				int fd;
+				std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+				if (fds)
+				{
+					fds->push_back(fd);
+				}
+				else
+				{
+					::close(fd);
+				}
+			}
+		}
+
+		if (ch == '\n')
+		{
+			return true;
+		}
+		line.push_back(ch);
+	}
+}
+} // namespace server
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Resident mode: one long-lived `tmux-snippets-ui --daemon` keeps the storage in memory and
+// thin `tmux-snippets-client` processes connect to it over a Unix socket.
+//
+// Requests are single text lines, answers are text lines:
+//   session <pane>         + stdin/stdout of the client (SCM_RIGHTS); the daemon draws the
+//                          browser on them. The client then sends "winch" lines on resize;
+//                          the daemon answers "done" when the browser closes
+//   list [folder uuid]     "folder <uuid> <name>" and "snippet <uuid> <title>" lines, then "end"
+//   send <uuid> <pane> [name=value ...]
+//                          "ok" or "error <reason>"; the values fill the template variables
+//   quit                   "ok"; pending edits are written and the daemon exits
+//
+// While a session runs, any other request is answered "busy"; a client that wanted a session
+// then runs the browser itself.
+namespace server
+{
+// $XDG_RUNTIME_DIR/tmux-snippets.sock, or a private directory under /tmp. Empty when that
+// directory is not a 0700 directory owned by the current user
+std::filesystem::path socketPath();
+
+int connectTo(const std::filesystem::path& path);
+// Keeps an flock on <path>.lock open in lock for as long as the returned socket lives; both
+// are -1 when another daemon owns the path
+int listenOn(const std::filesystem::path& path, int& lock);
+
+// Only processes of the same user may talk to the daemon
+bool peerIsSameUser(int socket);
+
+// `line` is sent with a trailing newline, fds (if any) ride along with it
+bool sendLine(int socket, const std::string& line, const std::vector<int>& fds = {});
+
+// Reads up to the next newline (not included). Received fds are appended to `fds`, when given.
+bool receiveLine(int socket, std::string& line, std::vector<int>* fds = nullptr);
+} // namespace server
\ No newline at end of file
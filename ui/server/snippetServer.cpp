@@ -0,0 +1,387 @@
+#include "server/snippetServer.h"
+#include "server/protocol.h"
+
+#include "browser/storageBrowser.h"
+
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace server
+{
+namespace
+{
+std::optional<uuids::uuid> parseUuid(const std::string& value)
+{
+	return uuids::uuid::from_string(value);
+}
+
+// Names and titles go on one protocol line
+std::string singleLine(std::string_view value)
+{
+	std::string result(value);
+	for (auto& ch : result)
+	{
+		if (ch == '\n' || ch == '\r')
+		{
+			ch = ' ';
+		}
+	}
+	return result;
+}
+
+// Points stdin/stdout at the client terminal for the duration of a session
+class terminalRedirect
+{
+public:
+	terminalRedirect(int input, int output)
+	: savedInput_(::dup(STDIN_FILENO))
+	, savedOutput_(::dup(STDOUT_FILENO))
+	{
+		::dup2(input, STDIN_FILENO);
+		::dup2(output, STDOUT_FILENO);
+	}
+
+	~terminalRedirect()
+	{
+		std::cout.flush();
+		::dup2(savedInput_, STDIN_FILENO);
+		::dup2(savedOutput_, STDOUT_FILENO);
+		::close(savedInput_);
+		::close(savedOutput_);
+	}
+
+	terminalRedirect(const terminalRedirect&) = delete;
+	terminalRedirect& operator= (const terminalRedirect&) = delete;
+
+private:
+	int savedInput_;
+	int savedOutput_;
+};
+} // namespace
+
+snippetServer::snippetServer(data::storageBackend& manager)
+: manager_(manager)
+, templates_(manager.getStorage())
+{ }
+
+snippetServer::~snippetServer()
+{
+	if (socket_ >= 0)
+	{
+		::close(socket_);
+		::unlink(path_.c_str());
+		// Released after the unlink so the next daemon's socket is never removed
+		::close(lock_);
+	}
+}
+
+bool snippetServer::listen(const std::filesystem::path& path)
+{
+	socket_ = listenOn(path, lock_);
+	path_ = path;
+	return socket_ >= 0;
+}
+
+void snippetServer::run()
+{
+	// A client that disappears mid-answer must not kill the daemon
+	std::signal(SIGPIPE, SIG_IGN);
+
+	while (true)
+	{
+		int client = ::accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+		if (client < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+
+		bool keepRunning = !peerIsSameUser(client) || serve(client);
+		::close(client);
+		if (!keepRunning)
+		{
+			return;
+		}
+	}
+}
+
+void snippetServer::rejectBusy()
+{
+	int client = ::accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+	if (client < 0)
+	{
+		return;
+	}
+
+	// The request is read first, so closing does not reset the connection before the answer arrives
+	std::string request;
+	std::vector<int> fds;
+	receiveLine(client, request, &fds);
+	for (auto fd : fds)
+	{
+		::close(fd);
+	}
+	sendLine(client, "busy");
+	::close(client);
+}
+
+bool snippetServer::serve(int client)
+{
+	std::string request;
+	std::vector<int> fds;
+	if (!receiveLine(client, request, &fds))
+	{
+		for (auto fd : fds)
+		{
+			::close(fd);
+		}
+		return true;
+	}
+
+	std::istringstream stream(request);
+	std::string command;
+	stream >> command;
+
+	if (command == "session")
+	{
+		std::string pane;
+		stream >> pane;
+		runSession(client, pane, fds);
+	}
+	else if (command == "list")
+	{
+		std::string folder;
+		stream >> folder;
+		listFolder(client, folder);
+	}
+	else if (command == "send")
+	{
+		std::string uuid, pane, value;
+		stream >> uuid >> pane;
+		// Template values follow as name=value words
+		std::unordered_map<std::string, std::string> values;
+		while (stream >> value)
+		{
+			auto equals = value.find('=');
+			if (equals != std::string::npos)
+			{
+				values[value.substr(0, equals)] = value.substr(equals + 1);
+			}
+		}
+		sendSnippet(client, uuid, pane, values);
+	}
+	else if (command == "quit")
+	{
+		sendLine(client, "ok");
+	}
+	else
+	{
+		sendLine(client, "error unknown request");
+	}
+
+	for (auto fd : fds)
+	{
+		::close(fd);
+	}
+	return command != "quit";
+}
+
+void snippetServer::runSession(int client, const std::string& pane, const std::vector<int>& fds)
+{
+	if (fds.size() != 2 || pane.empty())
+	{
+		sendLine(client, "error session needs a pane and two terminal fds");
+		return;
+	}
+
+	auto storage = manager_.getStorage();
+	storage->setRoot();
+
+	// Watches the client while the browser runs: resizes are replayed as SIGWINCH for the
+	// screen, a client that went away (window killed) closes the browser
+	std::mutex exitMutex;
+	std::function<void()> exitBrowser;
+	bool clientGone = false;
+	int stopPipe[2];
+	if (::pipe2(stopPipe, O_CLOEXEC) != 0)
+	{
+		sendLine(client, "error pipe");
+		return;
+	}
+
+	std::thread watcher(
+		[&]()
+		{
+			std::string line;
+			while (true)
+			{
+				pollfd watched[3] = { { client, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 }, { socket_, POLLIN, 0 } };
+				if (::poll(watched, 3, -1) < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					break;
+				}
+				if (watched[1].revents)
+				{
+					return;
+				}
+				if (watched[2].revents & POLLIN)
+				{
+					rejectBusy();
+				}
+				if (!watched[0].revents)
+				{
+					continue;
+				}
+				if (receiveLine(client, line) && line == "winch")
+				{
+					::kill(::getpid(), SIGWINCH);
+					continue;
+				}
+				break;
+			}
+
+			std::lock_guard lock(exitMutex);
+			clientGone = true;
+			if (exitBrowser)
+			{
+				exitBrowser();
+			}
+		});
+
+	{
+		terminalRedirect redirect(fds[0], fds[1]);
+		ui::runStorageBrowser(storage, pane, &manager_.getContentSearch(), &manager_.getUsage(),
+			[&](std::function<void()> exit)
+			{
+				std::lock_guard lock(exitMutex);
+				exitBrowser = std::move(exit);
+				if (clientGone)
+				{
+					exitBrowser();
+				}
+			});
+	}
+
+	{
+		std::lock_guard lock(exitMutex);
+		exitBrowser = nullptr;
+	}
+	// The pipe is empty, so the byte always fits
+	[[maybe_unused]] auto written = ::write(stopPipe[1], "x", 1);
+	watcher.join();
+	::close(stopPipe[0]);
+	::close(stopPipe[1]);
+
+	sendLine(client, "done");
+}
+
+void snippetServer::listFolder(int client, const std::string& folder)
+{
+	auto storage = manager_.getStorage();
+	auto lock = storage->lock();
+	auto target = storage->root();
+	if (!folder.empty())
+	{
+		auto uuid = parseUuid(folder);
+		if (!uuid)
+		{
+			sendLine(client, "error bad uuid");
+			return;
+		}
+
+		target = storage->findFolder(*uuid);
+		if (!target && !storage->fullyLoaded())
+		{
+			storage->loadAll();
+			target = storage->findFolder(*uuid);
+		}
+		if (!target)
+		{
+			sendLine(client, "error no such folder");
+			return;
+		}
+	}
+	storage->loadFolder(target);
+
+	std::string answer;
+	for (const auto& subFolder : target->subFolders_)
+	{
+		answer += "folder " + uuids::to_string(subFolder->uuid_) + " " + singleLine(subFolder->name_) + "\n";
+	}
+	for (const auto& snippet : target->snippets_)
+	{
+		answer += "snippet " + uuids::to_string(snippet->uuid) + " " + singleLine(snippet->title) + "\n";
+	}
+	answer += "end";
+	sendLine(client, answer);
+}
+
+void snippetServer::sendSnippet(int client, const std::string& uuid, const std::string& pane,
+	const std::unordered_map<std::string, std::string>& values)
+{
+	auto parsed = parseUuid(uuid);
+	if (!parsed || pane.empty())
+	{
+		sendLine(client, "error send needs a snippet uuid and a pane");
+		return;
+	}
+
+	auto storage = manager_.getStorage();
+	auto lock = storage->lock();
+	auto snippet = storage->findSnippet(*parsed);
+	if (!snippet && !storage->fullyLoaded())
+	{
+		storage->loadAll();
+		snippet = storage->findSnippet(*parsed);
+	}
+	if (!snippet)
+	{
+		sendLine(client, "error no such snippet");
+		return;
+	}
+
+	// Nobody to ask for the values here: variables without one and without a default fail the send
+	std::optional<std::string> filled;
+	if (auto parsed = templates_.get(*snippet))
+	{
+		std::string missing;
+		filled = parsed->fill(values, &missing);
+		if (!filled)
+		{
+			sendLine(client, "error no value for " + missing);
+			return;
+		}
+	}
+
+	auto failed = ui::sendSnippetToPane(snippet, pane, filled ? std::optional<std::string_view>(*filled) : std::nullopt);
+	if (!failed.empty())
+	{
+		std::string answer = "error failed";
+		for (const auto& target : failed)
+		{
+			answer += " " + target;
+		}
+		sendLine(client, answer);
+		return;
+	}
+	sendLine(client, "ok");
+}
+
+} // namespace server
\ No newline at end of file
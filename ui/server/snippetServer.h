@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include "data/snippetTemplate.h"
+#include "data/storageBackend.h"
+
+namespace server
+{
+
+// The daemon side of the resident mode (see server/protocol.h). Clients are served one at a
+// time: a session owns the terminal it was handed until the browser closes, and clients that
+// connect meanwhile are answered "busy".
+class snippetServer
+{
+public:
+	explicit snippetServer(data::storageBackend& manager);
+	~snippetServer();
+
+	// False when the socket cannot be bound or another daemon already holds it
+	bool listen(const std::filesystem::path& path);
+
+	// Accepts clients until a quit request
+	void run();
+
+private:
+	// Returns false on quit
+	bool serve(int client);
+
+	// Accepts a pending client and answers "busy"; used while a session holds the terminal
+	void rejectBusy();
+
+	void runSession(int client, const std::string& pane, const std::vector<int>& fds);
+	void listFolder(int client, const std::string& folder);
+	void sendSnippet(int client, const std::string& uuid, const std::string& pane, const std::unordered_map<std::string, std::string>& values);
+
+	data::storageBackend& manager_;
+	data::templateCache templates_;
+	std::filesystem::path path_;
+	int socket_ { -1 };
+	int lock_ { -1 };
+};
+
+} // namespace server
\ No newline at end of file
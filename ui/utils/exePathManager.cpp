@@ -38,6 +38,11 @@ std::filesystem::path exePathManager::getStoragePath() const
 	return getExeDir() / "data" / "storage.xml";
 }
 
+std::filesystem::path exePathManager::getDatabasePath() const
+{
+	return getExeDir() / "data" / "storage.db";
+}
+
 std::filesystem::path exePathManager::getFileSnippetPath(const std::string& filename) const
 {
 	std::filesystem::path filePath(filename);
@@ -22,6 +22,7 @@ public:
 	const std::filesystem::path& getExePath() const;
 	const std::filesystem::path& getExeDir() const;
 	std::filesystem::path getStoragePath() const;
+	std::filesystem::path getDatabasePath() const;
 	std::filesystem::path getFileSnippetPath(const std::string& filename) const;
 	bool isInitialized() const;
 };
@@ -0,0 +1,162 @@
+#include "utils/fileSnippetCache.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/finally.h"
+
+namespace utils
+{
+
+fileSnippetCache& fileSnippetCache::getInstance()
+{
+	static fileSnippetCache instance;
+	return instance;
+}
+
+fileSnippetCache::~fileSnippetCache()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_one();
+	if (prefetcher_.joinable())
+	{
+		prefetcher_.join();
+	}
+}
+
+fileSnippetCache::content_ptr_t fileSnippetCache::get(const std::filesystem::path& file)
+{
+	auto stampOf = [](const struct stat& info)
+	{
+		return fileStamp { static_cast<uint64_t>(info.st_dev), static_cast<uint64_t>(info.st_ino), static_cast<uint64_t>(info.st_size),
+			static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec };
+	};
+
+	auto key = file.string();
+	struct stat info {};
+	if (::stat(key.c_str(), &info) != 0 || !S_ISREG(info.st_mode) || static_cast<uint64_t>(info.st_size) > maxFileSize)
+	{
+		std::lock_guard lock(mutex_);
+		entries_.erase(key);
+		return nullptr;
+	}
+
+	{
+		std::lock_guard lock(mutex_);
+		auto found = entries_.find(key);
+		if (found != entries_.end() && found->second.stamp == stampOf(info))
+		{
+			found->second.lastUse = ++useCounter_;
+			return found->second.content;
+		}
+	}
+
+	int fd = ::open(key.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+	finally closeFile([fd] { ::close(fd); });
+
+	// The stamp of what is actually read, the path may have been replaced since the stat
+	if (::fstat(fd, &info) != 0)
+	{
+		return nullptr;
+	}
+
+	// Up to the end of the file as it is now; a file that grew past the limit meanwhile is streamed
+	std::string text;
+	text.resize(maxFileSize + 1);
+	size_t length = 0;
+	while (length < text.size())
+	{
+		auto received = ::read(fd, text.data() + length, text.size() - length);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (received < 0)
+		{
+			return nullptr;
+		}
+		if (received == 0)
+		{
+			break;
+		}
+		length += received;
+	}
+	if (length > maxFileSize)
+	{
+		return nullptr;
+	}
+	text.resize(length);
+	auto content = std::make_shared<const fileSnippetCache::content>(std::move(text));
+
+	std::lock_guard lock(mutex_);
+	entries_[key] = { stampOf(info), content, ++useCounter_ };
+	evict();
+	return content;
+}
+
+void fileSnippetCache::prefetch(std::vector<std::filesystem::path> files)
+{
+	{
+		std::lock_guard lock(mutex_);
+		queue_.assign(std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+		if (queue_.empty())
+		{
+			return;
+		}
+		if (!prefetcher_.joinable())
+		{
+			prefetcher_ = std::thread(&fileSnippetCache::run, this);
+		}
+	}
+	wake_.notify_one();
+}
+
+void fileSnippetCache::run()
+{
+	std::unique_lock lock(mutex_);
+	while (true)
+	{
+		wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+		if (stopping_)
+		{
+			return;
+		}
+
+		auto file = std::move(queue_.front());
+		queue_.pop_front();
+		lock.unlock();
+		get(file);
+		lock.lock();
+	}
+}
+
+// Drops the least recently used content; senders holding it keep it until they are done
+void fileSnippetCache::evict()
+{
+	if (entries_.size() <= maxEntries)
+	{
+		return;
+	}
+
+	auto oldest = entries_.begin();
+	for (auto it = entries_.begin(); it != entries_.end(); ++it)
+	{
+		if (it->second.lastUse < oldest->second.lastUse)
+		{
+			oldest = it;
+		}
+	}
+	entries_.erase(oldest);
+}
+
+} // namespace utils
\ No newline at end of file
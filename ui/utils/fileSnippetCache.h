@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace utils
+{
+// Contents of the files of from_file snippets, read into memory. A lookup costs one stat: the
+// content is reused while device, inode, size and mtime stay the same, an edited or replaced file
+// is read again. Senders get a view of the content, which stays valid while they hold it.
+//
+// Files over maxFileSize are not kept; senders stream them instead (see utils::sendFileToTmux).
+// Nothing is mapped, so a file truncated while it is being sent cannot fault the process.
+class fileSnippetCache
+{
+public:
+	class content
+	{
+	public:
+		explicit content(std::string text)
+		: text_(std::move(text))
+		{ }
+
+		std::string_view text() const { return text_; }
+
+	private:
+		std::string text_;
+	};
+	using content_ptr_t = std::shared_ptr<const content>;
+
+	static fileSnippetCache& getInstance();
+
+	fileSnippetCache(const fileSnippetCache&) = delete;
+	fileSnippetCache& operator=(const fileSnippetCache&) = delete;
+	~fileSnippetCache();
+
+	// The current content of the file, nullptr when it cannot be read or is over maxFileSize
+	content_ptr_t get(const std::filesystem::path& file);
+
+	// Reads the files in a background thread, so a later get finds them in memory.
+	// Replaces what is still queued from an earlier call.
+	void prefetch(std::vector<std::filesystem::path> files);
+
+	static constexpr size_t maxFileSize = 64 * 1024;
+	// Contents kept for files that were not used lately are dropped above this count
+	static constexpr size_t maxEntries = 256;
+
+private:
+	struct fileStamp
+	{
+		uint64_t device { 0 };
+		uint64_t inode { 0 };
+		uint64_t size { 0 };
+		int64_t mtime { 0 };
+
+		bool operator==(const fileStamp&) const = default;
+	};
+
+	struct entry
+	{
+		fileStamp stamp;
+		content_ptr_t content;
+		uint64_t lastUse { 0 };
+	};
+
+	fileSnippetCache() = default;
+	void run();
+	void evict();
+
+	std::mutex mutex_;
+	std::unordered_map<std::string, entry> entries_;
+	uint64_t useCounter_ { 0 };
+
+	std::condition_variable wake_;
+	std::deque<std::filesystem::path> queue_;
+	bool stopping_ { false };
+	std::thread prefetcher_;
+};
+} // namespace utils
\ No newline at end of file
@@ -1,13 +1,112 @@
 #include "utils/generate_uuid.h"
 
-uuids::uuid utils::generate_uuid()
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace
+{
+// Seeding used to read a full mt19937 state (624 words) from the random device on every call
+std::mt19937_64& engine()
+{
+	thread_local std::mt19937_64 generator = []
+	{
+		std::random_device device;
+		std::seed_seq seed { device(), device(), device(), device(), device(), device(), device(), device() };
+		return std::mt19937_64(seed);
+	}();
+	return generator;
+}
+
+uuids::uuid makeRandom(std::mt19937_64& random)
+{
+	std::array<uint8_t, 16> bytes;
+	uint64_t high = random();
+	uint64_t low = random();
+	for (size_t i = 0; i < 8; i++)
+	{
+		bytes[i] = static_cast<uint8_t>(high >> (56 - i * 8));
+		bytes[8 + i] = static_cast<uint8_t>(low >> (56 - i * 8));
+	}
+	bytes[6] = (bytes[6] & 0x0F) | 0x40;
+	bytes[8] = (bytes[8] & 0x3F) | 0x80;
+	return uuids::uuid(bytes);
+}
+
+// Last stamp handed out: milliseconds << 12 | counter. A counter running over moves the stamp
+// into the next millisecond ahead of the clock, which keeps the order.
+std::atomic<uint64_t> lastStamp { 0 };
+
+// First of count consecutive stamps, all after every stamp handed out before
+uint64_t reserveStamps(size_t count)
+{
+	auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	uint64_t clockStamp = static_cast<uint64_t>(now) << 12;
+	uint64_t last = lastStamp.load(std::memory_order_relaxed);
+	uint64_t first;
+	do
+	{
+		first = std::max(clockStamp, last + 1);
+	} while (!lastStamp.compare_exchange_weak(last, first + count - 1, std::memory_order_relaxed));
+	return first;
+}
+
+uuids::uuid makeTimeOrdered(uint64_t stamp, std::mt19937_64& random)
+{
+	std::array<uint8_t, 16> bytes;
+	uint64_t milliseconds = stamp >> 12;
+	for (size_t i = 0; i < 6; i++)
+	{
+		bytes[i] = static_cast<uint8_t>(milliseconds >> (40 - i * 8));
+	}
+	bytes[6] = 0x70 | static_cast<uint8_t>((stamp >> 8) & 0x0F);
+	bytes[7] = static_cast<uint8_t>(stamp);
+	uint64_t tail = random();
+	for (size_t i = 0; i < 8; i++)
+	{
+		bytes[8 + i] = static_cast<uint8_t>(tail >> (56 - i * 8));
+	}
+	bytes[8] = (bytes[8] & 0x3F) | 0x80;
+	return uuids::uuid(bytes);
+}
+} // namespace
+
+uuids::uuid utils::generate_uuid(uuid_kind kind)
+{
+	if (kind == uuid_kind::time_ordered)
+	{
+		return makeTimeOrdered(reserveStamps(1), engine());
+	}
+	return makeRandom(engine());
+}
+
+std::vector<uuids::uuid> utils::generate_uuids(size_t count, uuid_kind kind)
 {
-	static std::random_device rd;
-	static auto seed_data = std::array<int, std::mt19937::state_size> {};
-	std::generate(std::begin(seed_data), std::end(seed_data), std::ref(rd));
-	static std::seed_seq seq(std::begin(seed_data), std::end(seed_data));
-	static std::mt19937 generator(seq);
-	static uuids::uuid_random_generator gen { generator };
+	std::vector<uuids::uuid> result;
+	if (count == 0)
+	{
+		return result;
+	}
 
-	return gen();
+	result.reserve(count);
+	auto& random = engine();
+	if (kind == uuid_kind::time_ordered)
+	{
+		auto stamp = reserveStamps(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			result.push_back(makeTimeOrdered(stamp + i, random));
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			result.push_back(makeRandom(random));
+		}
+	}
+	return result;
 }
\ No newline at end of file
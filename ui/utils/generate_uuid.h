@@ -1,8 +1,24 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 #include <uuid.h>
 
 namespace utils
 {
-uuids::uuid generate_uuid();
+enum class uuid_kind
+{
+	// Version 4: all random
+	random,
+	// Version 7: Unix time in milliseconds, then a counter and random bits. The uuids of a
+	// process strictly increase, so they sort in creation order.
+	time_ordered
+};
+
+// The generator behind them is seeded once per thread from std::random_device
+uuids::uuid generate_uuid(uuid_kind kind = uuid_kind::random);
+
+// For bulk creation: the time-ordered ones share one clock read and one counter reservation
+std::vector<uuids::uuid> generate_uuids(size_t count, uuid_kind kind = uuid_kind::random);
 } // namespace utils
\ No newline at end of file
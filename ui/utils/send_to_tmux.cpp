@@ -3,61 +3,644 @@
 #include <cstdio>
 #include <memory>
 #include <sstream>
-#include <fstream>
+#include <vector>
+#include <cerrno>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string_view>
 
+#include <spawn.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "utils/fileSnippetCache.h"
+#include "utils/finally.h"
 #include "utils/send_to_tmux.h"
+#include "utils/tmuxControl.h"
+
+extern char** environ;
+
+static std::unique_ptr<utils::tmuxControl> controlConnection;
+
+// Produces content by calling the writer with consecutive chunks; false when a write failed
+using chunkWriter = std::function<bool(std::string_view)>;
+using contentProducer = std::function<bool(const chunkWriter&)>;
 
-static std::string executeCommand(const std::string& command)
+// Runs the command through sh; true when it exited with status 0
+static bool executeCommand(const std::string& command)
 {
 	char buffer[128];
-	std::string result = "";
 
 	// Открываем pipe для чтения вывода команды
-	std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
-
+	FILE* pipe = popen(command.c_str(), "r");
 	if (!pipe)
 	{
-		throw std::runtime_error("popen() failed!");
+		return false;
 	}
 
-	while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr)
+	// Drained, so the command never blocks on a full pipe
+	while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+	{ }
+
+	int status = pclose(pipe);
+	return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Appends the argument in single quotes for sh, in one pass over its quote-free runs
+static void appendSingleQuoted(std::string& out, std::string_view input)
+{
+	out += '\'';
+	for (size_t start = 0;;)
 	{
-		result += buffer;
+		auto quote = input.find('\'', start);
+		out.append(input.substr(start, quote - start));
+		if (quote == std::string_view::npos)
+		{
+			break;
+		}
+		out += "'\\''";
+		start = quote + 1;
 	}
+	out += '\'';
+}
 
-	return result;
+// Runs tmux with the given arguments, without a shell. With input, it is written to the
+// standard input of tmux chunk by chunk as the callback produces it; with output, the standard
+// output of tmux is collected there.
+static bool runTmux(const std::vector<std::string>& args, const contentProducer& input = nullptr, std::string* output = nullptr)
+{
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>("tmux"));
+	for (const auto& arg : args)
+	{
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	// A socket rather than a pipe, so a tmux that exits early fails the write instead of raising SIGPIPE
+	int fds[2] = { -1, -1 };
+	if (input && ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+	{
+		return false;
+	}
+
+	int outFds[2] = { -1, -1 };
+	if (output && ::pipe2(outFds, O_CLOEXEC) != 0)
+	{
+		if (input)
+		{
+			::close(fds[0]);
+			::close(fds[1]);
+		}
+		return false;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (input)
+	{
+		posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+	}
+	if (output)
+	{
+		posix_spawn_file_actions_adddup2(&actions, outFds[1], STDOUT_FILENO);
+	}
+	// Errors are reported through the result, not over the screen of the browser
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+	pid_t pid = -1;
+	int spawned = ::posix_spawnp(&pid, "tmux", &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	bool written = true;
+	if (input)
+	{
+		::close(fds[1]);
+		if (spawned == 0)
+		{
+			written = input(
+				[&](std::string_view chunk) -> bool
+				{
+					while (!chunk.empty())
+					{
+						auto result = ::send(fds[0], chunk.data(), chunk.size(), MSG_NOSIGNAL);
+						if (result < 0 && errno == EINTR)
+						{
+							continue;
+						}
+						if (result <= 0)
+						{
+							return false;
+						}
+						chunk.remove_prefix(result);
+					}
+					return true;
+				});
+		}
+		::close(fds[0]);
+	}
+
+	if (output)
+	{
+		::close(outFds[1]);
+		char buffer[4096];
+		ssize_t received;
+		while (spawned == 0 && ((received = ::read(outFds[0], buffer, sizeof(buffer))) > 0 || (received < 0 && errno == EINTR)))
+		{
+			if (received > 0)
+			{
+				output->append(buffer, received);
+			}
+		}
+		::close(outFds[0]);
+	}
+
+	if (spawned != 0)
+	{
+		return false;
+	}
+
+	int status = 0;
+	while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+	{
+	}
+	return written && WIFEXITED(status) && WEXITSTATUS(status) == 0;
 }
 
-static std::string escapeSingleQuotes(const std::string& input)
+enum class controlSend
 {
-	std::string result;
-	for (char c : input)
+	// Nothing was written, the send-keys fallback may type the lines
+	unavailable,
+	sent,
+	// The connection broke after some commands were written; tmux may have run them, so
+	// typing the lines again could run a command twice
+	broken
+};
+
+static controlSend sendOverControl(const std::vector<std::string>& lines, const std::string& target)
+{
+	if (!controlConnection)
+	{
+		return controlSend::unavailable;
+	}
+	// A resident process outlives sessions and servers, a lost client is started again once
+	if (!controlConnection->alive() && !controlConnection->connect())
+	{
+		return controlSend::unavailable;
+	}
+
+	// -l: the line is text, not key names
+	auto sendKeys = "send-keys -t " + utils::tmuxControl::quote(target);
+	auto result = controlSend::sent;
+	for (size_t i = 0; i < lines.size() && result == controlSend::sent; i++)
 	{
-		if (c == '\'')
+		if (!controlConnection->send(sendKeys + " -l " + utils::tmuxControl::quote(lines[i])))
 		{
-			result += "'\\''";
+			result = i == 0 ? controlSend::unavailable : controlSend::broken;
 		}
-		else
+		else if (!controlConnection->send(sendKeys + " Enter"))
 		{
-			result += c;
+			result = controlSend::broken;
 		}
 	}
+
+	// A client that cannot attach would only add a spawn to every fallback send
+	if (result != controlSend::sent && !controlConnection->alive())
+	{
+		controlConnection.reset();
+	}
 	return result;
 }
 
-void utils::sendCommandToTmux(const std::string& command, const std::string& target)
+bool utils::openTmuxControl()
+{
+	controlConnection = std::make_unique<tmuxControl>();
+	if (!controlConnection->connect())
+	{
+		controlConnection.reset();
+		return false;
+	}
+	return true;
+}
+
+void utils::closeTmuxControl()
 {
-	std::istringstream stream(command);
-	std::string line;
-	std::string fullCommand = "tmux send-keys -t " + target;
+	controlConnection.reset();
+}
+
+static bool bracketedPaste = false;
+
+void utils::setBracketedPaste(bool enabled)
+{
+	bracketedPaste = enabled;
+}
 
-	while (std::getline(stream, line))
+// Streams the content into the named buffer. paste-buffer turns line feeds into Enter; without
+// a bracketed paste the content gets a trailing one, so the last line runs like with send-keys.
+static bool loadBuffer(const std::string& buffer, const contentProducer& content)
+{
+	return runTmux({ "load-buffer", "-b", buffer, "-" },
+		[&](const chunkWriter& write)
+		{
+			char last = '\n';
+			bool written = content(
+				[&](std::string_view chunk)
+				{
+					if (!chunk.empty())
+					{
+						last = chunk.back();
+					}
+					return write(chunk);
+				});
+			return written && (bracketedPaste || last == '\n' || write("\n"));
+		});
+}
+
+static std::vector<std::string> pasteCommand(const std::string& buffer, const std::string& target, bool deleteAfter)
+{
+	std::vector<std::string> paste { "paste-buffer", "-b", buffer, "-t", target };
+	if (deleteAfter)
+	{
+		paste.push_back("-d");
+	}
+	if (bracketedPaste)
 	{
+		paste.push_back("-p");
+	}
+	return paste;
+}
+
+static std::string controlCommand(const std::vector<std::string>& args)
+{
+	std::string command;
+	for (const auto& arg : args)
+	{
+		if (!command.empty())
+		{
+			command += ' ';
+		}
+		command += utils::tmuxControl::quote(arg);
+	}
+	return command;
+}
+
+// Pastes the content through a buffer of its own. A paste that works deletes it; whatever went
+// wrong, the buffer is deleted afterwards too, so no snippets-* buffer is left in the server.
+static bool pasteToTmux(const contentProducer& content, const std::string& target)
+{
+	auto buffer = "tmux-snippets-" + std::to_string(::getpid());
+	std::vector<std::string> deleteBuffer { "delete-buffer", "-b", buffer };
+	// A load that failed halfway may still have left a buffer
+	if (!loadBuffer(buffer, content))
+	{
+		runTmux(deleteBuffer);
+		return false;
+	}
+
+	auto paste = pasteCommand(buffer, target, true);
+	if (controlConnection && controlConnection->alive() && controlConnection->send(controlCommand(paste)))
+	{
+		// Run after the paste; only does something when the paste failed
+		controlConnection->send(controlCommand(deleteBuffer));
+		return true;
+	}
+	if (!runTmux(paste))
+	{
+		runTmux(deleteBuffer);
+		return false;
+	}
+	return true;
+}
+
+// tmux takes an argument ending in ";" for a command separator and drops the backslash of a
+// final "\;", so a backslash before the last ";" keeps any argument as it is
+static std::string escapeSeparator(std::string argument)
+{
+	if (argument.ends_with(';'))
+	{
+		argument.insert(argument.size() - 1, 1, '\\');
+	}
+	return argument;
+}
+
+static std::vector<std::string> splitLines(std::string_view command)
+{
+	std::vector<std::string> lines;
+	while (!command.empty())
+	{
+		auto end = command.find('\n');
+		auto line = command.substr(0, end);
 		if (!line.empty())
 		{
-			fullCommand += " '" + escapeSingleQuotes(line) + "' Enter";
+			lines.emplace_back(line);
 		}
+		command.remove_prefix(end == std::string_view::npos ? command.size() : end + 1);
 	}
+	return lines;
+}
 
-	executeCommand(fullCommand);
+bool utils::sendCommandToTmux(std::string_view command, const std::string& target)
+{
+	if (bracketedPaste || command.size() > pasteThreshold)
+	{
+		auto streamed = pasteToTmux([&](const auto& write) { return write(command); }, target);
+		if (streamed)
+		{
+			return true;
+		}
+	}
+
+	auto lines = splitLines(command);
+	auto overControl = sendOverControl(lines, target);
+	if (overControl != controlSend::unavailable)
+	{
+		return overControl == controlSend::sent;
+	}
+
+	std::string fullCommand = "tmux send-keys -t ";
+	fullCommand.reserve(fullCommand.size() + target.size() + command.size() + lines.size() * 16);
+	appendSingleQuoted(fullCommand, target);
+	for (const auto& line : lines)
+	{
+		fullCommand += ' ';
+		appendSingleQuoted(fullCommand, escapeSeparator(line));
+		fullCommand += " Enter";
+	}
+
+	return executeCommand(fullCommand);
+}
+
+// Reads the file in chunks as they are written, so a large file is never held in memory
+static contentProducer fileProducer(const std::filesystem::path& file)
+{
+	return [file](const chunkWriter& write)
+	{
+		int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+		utils::finally closeFile([fd] { ::close(fd); });
+
+		char buffer[64 * 1024];
+		while (true)
+		{
+			auto received = ::read(fd, buffer, sizeof(buffer));
+			if (received < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (received <= 0)
+			{
+				return received == 0;
+			}
+			if (!write(std::string_view(buffer, received)))
+			{
+				return false;
+			}
+		}
+	};
+}
+
+static bool isLargeFile(const std::filesystem::path& file)
+{
+	std::error_code ec;
+	auto size = std::filesystem::file_size(file, ec);
+	return !ec && size > utils::fileSnippetCache::maxFileSize;
+}
+
+bool utils::sendFileToTmux(const std::filesystem::path& file, const std::string& target)
+{
+	// Held until the send is done, a newer version of the file does not replace it meanwhile
+	if (auto content = fileSnippetCache::getInstance().get(file))
+	{
+		return sendCommandToTmux(content->text(), target);
+	}
+	return isLargeFile(file) && pasteToTmux(fileProducer(file), target);
+}
+
+std::vector<std::string> utils::resolveTmuxTargets(const std::string& spec, std::vector<std::string>* unresolved)
+{
+	std::vector<std::string> targets;
+	auto listPanes = [&](std::vector<std::string> args, const std::function<bool(std::string_view)>& accept)
+	{
+		auto found = targets.size();
+		std::string output;
+		runTmux(args, nullptr, &output);
+		std::istringstream stream(output);
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			auto id = line.substr(0, line.find('\t'));
+			if (!id.empty() && accept(line))
+			{
+				targets.push_back(id);
+			}
+		}
+		return targets.size() > found;
+	};
+
+	std::istringstream entries(spec);
+	std::string entry;
+	while (std::getline(entries, entry, ','))
+	{
+		bool resolved = true;
+		if (entry.starts_with("window:"))
+		{
+			resolved = listPanes({ "list-panes", "-t", entry.substr(7), "-F", "#{pane_id}" }, [](std::string_view) { return true; });
+		}
+		else if (entry.starts_with("match:"))
+		{
+			// Glob over the pane title and the command running in it, in every session
+			auto pattern = entry.substr(6);
+			resolved = listPanes({ "list-panes", "-a", "-F", "#{pane_id}\t#{pane_title}\t#{pane_current_command}" },
+				[&pattern](std::string_view line)
+				{
+					auto title = line.substr(line.find('\t') + 1);
+					auto command = title.substr(title.find('\t') + 1);
+					title = title.substr(0, title.find('\t'));
+					return ::fnmatch(pattern.c_str(), std::string(title).c_str(), 0) == 0 || ::fnmatch(pattern.c_str(), std::string(command).c_str(), 0) == 0;
+				});
+		}
+		else if (!entry.empty())
+		{
+			targets.push_back(entry);
+		}
+
+		if (!resolved && unresolved)
+		{
+			unresolved->push_back(entry);
+		}
+	}
+
+	// Overlapping entries name a pane once, in the order it first came
+	std::vector<std::string> unique;
+	for (auto& target : targets)
+	{
+		if (std::find(unique.begin(), unique.end(), target) == unique.end())
+		{
+			unique.push_back(std::move(target));
+		}
+	}
+	return unique;
+}
+
+bool utils::isBroadcastTarget(const std::string& spec)
+{
+	return spec.find(',') != std::string::npos || spec.starts_with("window:") || spec.starts_with("match:");
+}
+
+// Same content to every target. Over the control connection all commands are written at once and
+// the replies checked afterwards; the panes that could not be handled there go to a pool of workers
+// that each run tmux for one pane at a time. A large content is loaded into one buffer for all panes.
+static std::vector<utils::sendResult> broadcast(const std::vector<std::string>& lines, const contentProducer& pasted,
+	const std::vector<std::string>& targets, size_t workers)
+{
+	std::vector<utils::sendResult> results;
+	for (const auto& target : targets)
+	{
+		results.push_back({ target, false });
+	}
+
+	auto buffer = "tmux-snippets-" + std::to_string(::getpid()) + "-broadcast";
+	// A load that failed halfway may still have left a buffer
+	if (pasted && !loadBuffer(buffer, pasted))
+	{
+		runTmux({ "delete-buffer", "-b", buffer });
+		return results;
+	}
+
+	auto commandsFor = [&](const std::string& target)
+	{
+		std::vector<std::vector<std::string>> commands;
+		if (pasted)
+		{
+			commands.push_back(pasteCommand(buffer, target, false));
+		}
+		else
+		{
+			for (const auto& line : lines)
+			{
+				commands.push_back({ "send-keys", "-t", target, "-l", line });
+				commands.push_back({ "send-keys", "-t", target, "Enter" });
+			}
+		}
+		return commands;
+	};
+
+	std::vector<size_t> pending;
+	if (controlConnection && (controlConnection->alive() || controlConnection->connect()))
+	{
+		std::vector<std::vector<size_t>> tickets(targets.size());
+		std::vector<bool> complete(targets.size(), true);
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			for (const auto& command : commandsFor(targets[i]))
+			{
+				auto ticket = controlConnection->send(controlCommand(command));
+				if (!ticket)
+				{
+					complete[i] = false;
+					break;
+				}
+				tickets[i].push_back(*ticket);
+			}
+		}
+
+		controlConnection->waitIdle(std::chrono::milliseconds(5000));
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			results[i].ok = complete[i];
+			for (auto ticket : tickets[i])
+			{
+				results[i].ok = results[i].ok && controlConnection->succeeded(ticket).value_or(false);
+			}
+			// Only panes the control client never reached are tried again: a refused command would be
+			// refused again, and a half sent one would be typed twice
+			if (tickets[i].empty() && !complete[i])
+			{
+				pending.push_back(i);
+			}
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			pending.push_back(i);
+		}
+	}
+
+	// One tmux per pane, its commands separated by ";" arguments; a ";" ending a line is escaped,
+	// or it would split the command
+	std::atomic<size_t> next { 0 };
+	auto worker = [&]()
+	{
+		for (size_t i; (i = next++) < pending.size();)
+		{
+			std::vector<std::string> args;
+			for (const auto& command : commandsFor(targets[pending[i]]))
+			{
+				if (!args.empty())
+				{
+					args.push_back(";");
+				}
+				for (const auto& arg : command)
+				{
+					args.push_back(escapeSeparator(arg));
+				}
+			}
+			results[pending[i]].ok = args.empty() || runTmux(args);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t i = 0; i < std::min(workers, pending.size()); i++)
+	{
+		pool.emplace_back(worker);
+	}
+	for (auto& thread : pool)
+	{
+		thread.join();
+	}
+
+	if (pasted)
+	{
+		runTmux({ "delete-buffer", "-b", buffer });
+	}
+	return results;
+}
+
+std::vector<utils::sendResult> utils::broadcastToTmux(std::string_view command, const std::vector<std::string>& targets, size_t workers)
+{
+	if (bracketedPaste || command.size() > pasteThreshold)
+	{
+		return broadcast({}, [&](const chunkWriter& write) { return write(command); }, targets, workers);
+	}
+	return broadcast(splitLines(command), nullptr, targets, workers);
+}
+
+std::vector<utils::sendResult> utils::broadcastFileToTmux(const std::filesystem::path& file, const std::vector<std::string>& targets, size_t workers)
+{
+	auto content = fileSnippetCache::getInstance().get(file);
+	if (!content)
+	{
+		// Streamed into the buffer when too large to keep; a file that cannot be read fails every target
+		return broadcast({}, isLargeFile(file) ? fileProducer(file) : [](const chunkWriter&) { return false; }, targets, workers);
+	}
+	return broadcastToTmux(content->text(), targets, workers);
+}
+
+void utils::displayTmuxMessage(const std::string& message)
+{
+	std::vector<std::string> display { "display-message", message };
+	if (!controlConnection || !controlConnection->alive() || !controlConnection->send(controlCommand(display)))
+	{
+		runTmux(display);
+	}
 }
\ No newline at end of file
@@ -1,8 +1,48 @@
 #pragma once
 
+#include <cstddef>
+#include <filesystem>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace utils
 {
-void sendCommandToTmux(const std::string& command, const std::string& target = "0");
+// Content above this size is pasted through a tmux buffer instead of typed line by line
+constexpr size_t pasteThreshold = 4096;
+
+// Types every non-empty line of command into the target pane, each followed by Enter.
+// Goes over the control mode connection when one is open, otherwise runs tmux send-keys.
+// False when the control connection broke partway: nothing is typed again, as tmux may
+// already have run part of it.
+bool sendCommandToTmux(std::string_view command, const std::string& target = "0");
+
+// Same for the content of a file, read through utils::fileSnippetCache; a file too large for
+// the cache is streamed into a paste buffer
+bool sendFileToTmux(const std::filesystem::path& file, const std::string& target);
+
+// Pastes everything as a bracketed paste: the shell shows the text but runs nothing until Enter
+void setBracketedPaste(bool enabled);
+
+// Targets of a broadcast, comma separated: pane targets as tmux takes them, "window:<target>" for
+// every pane of a window and "match:<glob>" for the panes whose title or running command matches.
+// Entries that name no pane are added to unresolved, when given.
+std::vector<std::string> resolveTmuxTargets(const std::string& spec, std::vector<std::string>* unresolved = nullptr);
+bool isBroadcastTarget(const std::string& spec);
+
+struct sendResult
+{
+	std::string target;
+	bool ok;
+};
+
+// Sends one content to many panes at once, with at most workers tmux processes running
+std::vector<sendResult> broadcastToTmux(std::string_view command, const std::vector<std::string>& targets, size_t workers = 8);
+std::vector<sendResult> broadcastFileToTmux(const std::filesystem::path& file, const std::vector<std::string>& targets, size_t workers = 8);
+
+void displayTmuxMessage(const std::string& message);
+
+// Opens the control mode connection used by later sends; closing waits for their replies
+bool openTmuxControl();
+void closeTmuxControl();
 }
\ No newline at end of file
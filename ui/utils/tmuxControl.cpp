@@ -0,0 +1,242 @@
+#include "utils/tmuxControl.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace utils
+{
+tmuxControl::~tmuxControl()
+{
+	close();
+}
+
+bool tmuxControl::connect()
+{
+	close();
+
+	// One socket for both directions: tmux gets it as stdin and stdout, and writes to a client
+	// that died end in EPIPE instead of SIGPIPE
+	int fds[2];
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+	{
+		return false;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+	char* argv[] = { const_cast<char*>("tmux"), const_cast<char*>("-C"), const_cast<char*>("attach-session"), nullptr };
+	int spawned = ::posix_spawnp(&pid_, "tmux", &actions, nullptr, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	::close(fds[1]);
+	if (spawned != 0)
+	{
+		pid_ = -1;
+		::close(fds[0]);
+		return false;
+	}
+
+	socket_ = fds[0];
+	{
+		std::lock_guard lock(mutex_);
+		alive_ = true;
+		attached_ = false;
+		sent_ = answered_ = errors_ = 0;
+		failed_.clear();
+	}
+	reader_ = std::thread(&tmuxControl::readReplies, this, socket_);
+	return true;
+}
+
+void tmuxControl::close()
+{
+	if (socket_ < 0)
+	{
+		return;
+	}
+
+	// Whatever was sent should reach the panes before the client detaches
+	waitIdle(std::chrono::milliseconds(500));
+
+	// EOF on its input detaches the client
+	::shutdown(socket_, SHUT_WR);
+	for (int i = 0; i < 50; i++)
+	{
+		if (::waitpid(pid_, nullptr, WNOHANG) == pid_)
+		{
+			pid_ = -1;
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (pid_ > 0)
+	{
+		::kill(pid_, SIGTERM);
+		::waitpid(pid_, nullptr, 0);
+		pid_ = -1;
+	}
+
+	reader_.join();
+	::close(socket_);
+	socket_ = -1;
+}
+
+std::optional<size_t> tmuxControl::send(const std::string& command, std::chrono::milliseconds attachTimeout)
+{
+	std::unique_lock lock(mutex_);
+	// Only waits the first time, to learn whether there is a client at all
+	changed_.wait_for(lock, attachTimeout, [this] { return attached_ || !alive_; });
+	if (!attached_)
+	{
+		return std::nullopt;
+	}
+	return writeLine(command);
+}
+
+std::optional<size_t> tmuxControl::writeLine(const std::string& command)
+{
+	auto line = command + "\n";
+	for (size_t written = 0; written < line.size();)
+	{
+		auto result = ::send(socket_, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			alive_ = false;
+			return std::nullopt;
+		}
+		written += result;
+	}
+	return sent_++;
+}
+
+bool tmuxControl::waitIdle(std::chrono::milliseconds timeout)
+{
+	std::unique_lock lock(mutex_);
+	return changed_.wait_for(lock, timeout, [this] { return answered_ >= sent_ || !alive_; }) && answered_ >= sent_;
+}
+
+std::optional<bool> tmuxControl::succeeded(size_t ticket) const
+{
+	std::lock_guard lock(mutex_);
+	if (ticket >= failed_.size())
+	{
+		return std::nullopt;
+	}
+	return !failed_[ticket];
+}
+
+bool tmuxControl::alive() const
+{
+	std::lock_guard lock(mutex_);
+	return alive_;
+}
+
+size_t tmuxControl::errorCount() const
+{
+	std::lock_guard lock(mutex_);
+	return errors_;
+}
+
+std::string tmuxControl::quote(std::string_view argument)
+{
+	// Inside double quotes tmux expands $ and ~ and treats \ as an escape
+	std::string result = "\"";
+	for (char c : argument)
+	{
+		if (c == '"' || c == '\\' || c == '$' || c == '~')
+		{
+			result += '\\';
+		}
+		result += c;
+	}
+	result += '"';
+	return result;
+}
+
+void tmuxControl::readReplies(int fd)
+{
+	// Every command is answered by "%begin <time> <number> <flags>", its output, and %end or %error
+	// with the same fields. Flags 1 marks the commands written by this client, flags 0 the
+	// attach-session of the command line. Other lines starting with % are notifications.
+	std::string pending;
+	bool inReply = false;
+	bool exited = false;
+	char buffer[4096];
+
+	while (!exited)
+	{
+		auto received = ::recv(fd, buffer, sizeof(buffer), 0);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (received <= 0)
+		{
+			break;
+		}
+		pending.append(buffer, received);
+
+		size_t start = 0;
+		for (auto end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start))
+		{
+			std::string_view line(pending.data() + start, end - start);
+			start = end + 1;
+
+			if (line.starts_with("%begin "))
+			{
+				inReply = true;
+			}
+			else if (inReply && (line.starts_with("%end ") || line.starts_with("%error ")))
+			{
+				inReply = false;
+				std::lock_guard lock(mutex_);
+				bool failed = line.starts_with("%error ");
+				if (line.ends_with(" 0"))
+				{
+					attached_ = !failed;
+					alive_ = !failed;
+					// The client must neither resize the windows nor receive their output. It only
+					// exists once attached; older servers answer with an error, which costs nothing.
+					if (attached_)
+					{
+						writeLine("refresh-client -f ignore-size,no-output");
+					}
+				}
+				else
+				{
+					answered_++;
+					errors_ += failed ? 1 : 0;
+					failed_.push_back(failed);
+				}
+				changed_.notify_all();
+			}
+			else if (!inReply && line.starts_with("%exit"))
+			{
+				exited = true;
+				break;
+			}
+		}
+		pending.erase(0, start);
+	}
+
+	std::lock_guard lock(mutex_);
+	alive_ = false;
+	changed_.notify_all();
+}
+} // namespace utils
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace utils
+{
+// A tmux control mode client (tmux -C attach-session) kept open while the process runs.
+// Commands are written to it as lines; a reader thread consumes the %begin/%end replies,
+// so send() only costs a write. tmux runs the commands of one client in order.
+class tmuxControl
+{
+public:
+	tmuxControl() = default;
+	~tmuxControl();
+
+	tmuxControl(const tmuxControl&) = delete;
+	tmuxControl& operator= (const tmuxControl&) = delete;
+
+	// Starts the client without waiting for it to attach
+	bool connect();
+	void close();
+
+	// Returns the ticket of the command, nothing when the client is gone or could not attach
+	// within the timeout
+	std::optional<size_t> send(const std::string& command, std::chrono::milliseconds attachTimeout = std::chrono::milliseconds(1000));
+
+	// Waits until tmux replied to every command sent so far
+	bool waitIdle(std::chrono::milliseconds timeout);
+
+	// Whether the command with this ticket succeeded; nothing while its reply has not come
+	std::optional<bool> succeeded(size_t ticket) const;
+
+	bool alive() const;
+	size_t errorCount() const;
+
+	// Argument in the tmux command language, double quoted
+	static std::string quote(std::string_view argument);
+
+private:
+	void readReplies(int fd);
+	// Called with the mutex held
+	std::optional<size_t> writeLine(const std::string& command);
+
+	pid_t pid_ { -1 };
+	int socket_ { -1 };
+	std::thread reader_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable changed_;
+	bool alive_ { false };
+	bool attached_ { false };
+	size_t sent_ { 0 };
+	size_t answered_ { 0 };
+	size_t errors_ { 0 };
+	// Outcome of every answered command, by ticket
+	std::vector<bool> failed_;
+};
+} // namespace utils
\ No newline at end of file